@@ -3,19 +3,103 @@
 #include <stdbool.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <signal.h>
+#include <pthread.h>
+
+// hot kernels get extra copies built for newer x86 instruction sets, picked at startup
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define KERNEL_DISPATCH
+#define TARGET_SSE42 __attribute__((target("sse4.2,popcnt")))
+#define TARGET_AVX2 __attribute__((target("avx2,bmi,bmi2,popcnt,sse4.2")))
+#endif
+
+// shared body of a kernel, inlined so every copy is compiled for its own instruction set
+#ifdef __GNUC__
+#define KERNEL_BODY static inline __attribute__((always_inline))
+#else
+#define KERNEL_BODY static inline
+#endif
 
 #define MAXCHAR 1024
 
+// distinct byte values
+#define ALPHABET_SIZE 256
+
+// bytes read from a file at a time while counting characters
+#define READ_BUFFER_SIZE (1024 * 1024)
+
+// files at least this large are counted from one block per stratum instead of a full pass
+#define SAMPLE_THRESHOLD (256 * 1024 * 1024)
+#define SAMPLE_BLOCKS 256
+#define SAMPLE_BLOCK_SIZE (64 * 1024)
+
+// .oats archives: header magic, blocks, then a trailing index and index magic
+// (solid archives add a shared tree after the header and a file table after the index)
+#define ARCHIVE_MAGIC "OATS"
+#define INDEX_MAGIC "OATI"
+#define SOLID_MAGIC "OATF"
+#define MAGIC_LENGTH 4
+
+// how a block's payload is coded
+#define BLOCK_HUFFMAN 0
+#define BLOCK_FOURSTREAMS 1
+#define BLOCK_BWT 2
+#define BLOCK_SHAREDTREE 4
+#define BLOCK_TOKENS 8
+
+// file table entry of an empty solid archive member
+#define NO_BLOCK UINT64_MAX
+
+// large blocks are split into interleaved bitstreams that decode in parallel
+#define STREAM_COUNT 4
+#define STREAM_THRESHOLD (64 * 1024)
+
+// characters per burrows-wheeler transformed block (rows must fit in 24 bits)
+#define BWT_BLOCK_SIZE (900 * 1024)
+
+// independent walks through one block when undoing the transform
+#define BWT_CHAINS 4
+
+// bits resolved by one decode table lookup
+#define TABLE_BITS 11
+
+// token mode: frequent words get their own symbols after the 256 byte values, which code everything else
+#define TOKEN_ALPHABET_SIZE 65536
+#define TOKEN_MIN_LENGTH 2
+#define TOKEN_MAX_LENGTH 32
+#define TOKEN_MIN_COUNT 4
+#define TOKEN_BLOCK_SIZE (16 * 1024 * 1024)
+#define TOKEN_HASH_SIZE (1 << 20)
+#define TOKEN_TABLE_BITS 14
+
+// files at least this large are encoded by several threads
+#define ENCODE_THREAD_THRESHOLD (16 * 1024 * 1024)
+#define ENCODE_THREADS 8
+
+// daemon limits for one request line, pending connections and open connections
+#define DAEMON_REQUEST_SIZE 2048
+#define DAEMON_BACKLOG 16
+#define DAEMON_CONNECTIONS 64
+
+// tags for nodes in a block's huffman tree
+#define TREE_INTERNAL '\0'
+#define TREE_LEAF '\1'
+
 // ** STRUCTS **
 
 // node
 typedef struct Node
 {
-    char character;
+    int character;
     int frequency;
     struct Node *leftPtr, *rightPtr;
 }
@@ -29,6 +113,122 @@ typedef struct minHeap
 }
 MINHEAP;
 
+// bits waiting to be written to a file (the newest bitCount bits of bitBuffer)
+typedef struct BitWriter
+{
+    int outputFile;
+    uint64_t bitBuffer;
+    int bitCount;
+    unsigned char outputBuffer[MAXCHAR];
+    int outputBufferIndex;
+    bool failed;
+}
+BITWRITER;
+
+// huffman code of one symbol as bits rather than a string
+typedef struct CodeWord
+{
+    uint64_t bits;
+    int length;
+}
+CODEWORD;
+
+// bits being read from a mapped bitstream (most significant bit first)
+typedef struct BitReader
+{
+    const unsigned char *data;
+    const unsigned char *end;
+    uint64_t bits;
+    int bitCount;
+}
+BITREADER;
+
+// decode table entry: a leaf reached within TABLE_BITS bits, or the node to keep walking from
+typedef struct DecodeEntry
+{
+    NODE *node;
+    int character;
+    unsigned char length;
+}
+DECODEENTRY;
+
+// slice of a mapped file for one encoding thread
+typedef struct XorTask
+{
+    unsigned char *data;
+    uint64_t size;
+    uint64_t offset;
+    const unsigned char *pattern;
+}
+XORTASK;
+
+// daemon state shared by every connection thread
+typedef struct DaemonState
+{
+    int server;
+    bool running;
+    int busy;
+    int connections;
+    pthread_mutex_t lock;
+    pthread_cond_t idle;
+}
+DAEMONSTATE;
+
+// one accepted daemon connection, served by its own thread
+typedef struct DaemonConnection
+{
+    int client;
+    DAEMONSTATE *state;
+}
+DAEMONCONNECTION;
+
+// one file packed into a solid archive
+typedef struct SolidMember
+{
+    char name[500];
+    const unsigned char *data;
+    uint64_t size;
+    uint64_t hash;
+    uint64_t duplicateOf;
+    uint64_t block;
+    uint64_t frequency[ALPHABET_SIZE];
+}
+SOLIDMEMBER;
+
+// distinct word seen while tokenizing a block (symbol stays 0 unless it joins the vocabulary)
+typedef struct TokenEntry
+{
+    const unsigned char *start;
+    uint64_t hash;
+    int length;
+    int count;
+    int symbol;
+}
+TOKENENTRY;
+
+// location of one independently coded block in an archive
+typedef struct IndexEntry
+{
+    uint64_t offset;
+    uint64_t length;
+    uint64_t originalSize;
+}
+INDEXENTRY;
+
+// hot kernels, one copy per instruction set
+typedef struct Kernels
+{
+    const char *name;
+    void (*countBytes)(const unsigned char *data, uint64_t size, int frequency[]);
+    void (*encodeSymbols)(BITWRITER *writer, const unsigned char *symbols, uint64_t count, const CODEWORD codeWords[]);
+    bool (*decodeSymbols)(const unsigned char *bits, uint64_t length, bool fourStreams, NODE *root, unsigned char *output, uint64_t count);
+    void (*xorChunks)(unsigned char *data, uint64_t chunks, const unsigned char pattern[MAXCHAR]);
+}
+KERNELS;
+
+// kernels chosen by SelectKernels at startup
+KERNELS kernels;
+
 
 
 
@@ -37,7 +237,7 @@ MINHEAP;
 // ** MIN HEAP AND HUFFMAN TREE CODE **
 
 // create a new node for minHeap
-NODE* CreateNewNode(char character, int frequency)
+NODE* CreateNewNode(int character, int frequency)
 {
     NODE *temp = malloc(sizeof(NODE));
 
@@ -92,13 +292,13 @@ void Heapify(MINHEAP *minHeap, int idx)
     }
 }
 
-// build min heap based on frequency numbers
-MINHEAP* BuildMinHeap(int frequency[])
+// build min heap based on frequency numbers (one entry per symbol below alphabetSize)
+MINHEAP* BuildMinHeap(int frequency[], int alphabetSize)
 {
     int size = 0;
 
     // find size for the minHeap
-    for(int i = 0; i < MAXCHAR; ++i)
+    for(int i = 0; i < alphabetSize; ++i)
     {
         if(frequency[i] > 0)
         {
@@ -114,11 +314,11 @@ MINHEAP* BuildMinHeap(int frequency[])
     int index = 0;
 
     // create nodes for character with non-zero frequencies
-    for(int i = 0; i < MAXCHAR; ++i)
+    for(int i = 0; i < alphabetSize; ++i)
     {
         if(frequency[i] > 0)
         {
-            minHeap->array[index] = CreateNewNode((char)i, frequency[i]);
+            minHeap->array[index] = CreateNewNode(i, frequency[i]);
             index++;
         }
     }
@@ -132,20 +332,38 @@ MINHEAP* BuildMinHeap(int frequency[])
     return minHeap;
 }
 
+// remove the smallest frequency node from the min heap
+NODE* ExtractMin(MINHEAP *minHeap)
+{
+    NODE *smallest = minHeap->array[0];
+    minHeap->array[0] = minHeap->array[minHeap->size - 1];
+    minHeap->size--;
+    Heapify(minHeap, 0);
+
+    return smallest;
+}
+
+// add a node to the min heap, moving it up past larger parents
+void InsertMinHeap(MINHEAP *minHeap, NODE *node)
+{
+    int idx = minHeap->size++;
+
+    while(idx > 0 && node->frequency < minHeap->array[(idx - 1) / 2]->frequency)
+    {
+        minHeap->array[idx] = minHeap->array[(idx - 1) / 2];
+        idx = (idx - 1) / 2;
+    }
+
+    minHeap->array[idx] = node;
+}
+
 NODE* BuildHuffmanTree(MINHEAP *minHeap)
 {
     while(minHeap->size != 1)
     {
         // extract smallest 2 frequency nodes from the min heap (left and right)
-        NODE *left = minHeap->array[0];
-        minHeap->array[0] = minHeap->array[minHeap->size - 1];
-        minHeap->size--;
-        Heapify(minHeap, 0);
-
-        NODE *right = minHeap->array[0];
-        minHeap->array[0] = minHeap->array[minHeap->size - 1];
-        minHeap->size--;
-        Heapify(minHeap, 0);
+        NODE *left = ExtractMin(minHeap);
+        NODE *right = ExtractMin(minHeap);
 
         // make the new node for the huffman tree
         NODE *top = CreateNewNode('$', left->frequency + right->frequency);
@@ -153,14 +371,7 @@ NODE* BuildHuffmanTree(MINHEAP *minHeap)
         top->rightPtr = right;
 
         // insert new node into min heap
-        minHeap->size++;
-        minHeap->array[minHeap->size - 1]= top;
-
-        // heapify to move smallest nodes up
-        for(int i = (minHeap->size - 1) / 2; i >= 0; --i)
-        {
-            Heapify(minHeap, i);
-        }
+        InsertMinHeap(minHeap, top);
     }
 
     //returns root node of Huffman Tree
@@ -188,30 +399,133 @@ void FreeHuffmanTree(NODE *root)
     free(root);
 }
 
-// counts how many times every character shows up in the file
-void CalculateFrequency(const char *fileName, int frequency[MAXCHAR])
+// add how many times every byte shows up in data to frequency
+KERNEL_BODY void CountBytesBody(const unsigned char *data, uint64_t size, int frequency[])
+{
+    // four tables so repeated bytes don't all wait on the same counter
+    uint32_t counts[4][ALPHABET_SIZE] = {{0}};
+    uint64_t i = 0;
+
+    for(; i + 4 <= size; i += 4)
+    {
+        counts[0][data[i]]++;
+        counts[1][data[i + 1]]++;
+        counts[2][data[i + 2]]++;
+        counts[3][data[i + 3]]++;
+    }
+
+    for(; i < size; ++i)
+    {
+        counts[0][data[i]]++;
+    }
+
+    for(int c = 0; c < ALPHABET_SIZE; ++c)
+    {
+        frequency[c] += counts[0][c] + counts[1][c] + counts[2][c] + counts[3][c];
+    }
+}
+
+void CountBytesScalar(const unsigned char *data, uint64_t size, int frequency[])
+{
+    CountBytesBody(data, size, frequency);
+}
+
+#ifdef KERNEL_DISPATCH
+TARGET_SSE42 void CountBytesSSE42(const unsigned char *data, uint64_t size, int frequency[])
+{
+    CountBytesBody(data, size, frequency);
+}
+
+TARGET_AVX2 void CountBytesAVX2(const unsigned char *data, uint64_t size, int frequency[])
+{
+    CountBytesBody(data, size, frequency);
+}
+#endif
+
+// count characters in SAMPLE_BLOCKS blocks spread evenly over a large file, one at a varying spot in each stratum
+void SampleFrequency(int inputFile, uint64_t size, int frequency[MAXCHAR])
+{
+    unsigned char *buffer = malloc(SAMPLE_BLOCK_SIZE);
+    if(buffer == NULL)
+    {
+        printf("Memory Allocation Failed\n");
+        exit(0);
+    }
+
+    uint64_t stratum = size / SAMPLE_BLOCKS;
+
+    for(uint64_t i = 0; i < SAMPLE_BLOCKS; ++i)
+    {
+        // same spots every run so the same file always gets the same tree
+        uint64_t offset = i * stratum + (i * 2654435761u) % (stratum - SAMPLE_BLOCK_SIZE + 1);
+
+        ssize_t bytesRead = pread(inputFile, buffer, SAMPLE_BLOCK_SIZE, offset);
+        if(bytesRead > 0)
+        {
+            kernels.countBytes(buffer, bytesRead, frequency);
+        }
+    }
+
+    free(buffer);
+}
+
+// sampling trades a slightly worse tree for one pass over the file, so it is opt in (OATS_SAMPLE=1)
+bool SampleLargeFile(uint64_t size)
+{
+    const char *sample = getenv("OATS_SAMPLE");
+    return size >= SAMPLE_THRESHOLD && sample != NULL && strcmp(sample, "1") == 0;
+}
+
+// counts how many times every character shows up in the file (estimated from a sample for large files with OATS_SAMPLE=1)
+bool CalculateFrequency(const char *fileName, int frequency[MAXCHAR])
 {
     int inputFile = open(fileName, O_RDONLY);
 
     if(inputFile == -1)
     {
         printf("File failed to open.\n");
+        return false;
+    }
+
+    struct stat fileInfo;
+    fstat(inputFile, &fileInfo);
+
+    if(SampleLargeFile(fileInfo.st_size))
+    {
+        SampleFrequency(inputFile, fileInfo.st_size, frequency);
+
+        // characters the sample missed still need a code
+        for(int i = 0; i < ALPHABET_SIZE; ++i)
+        {
+            if(frequency[i] == 0)
+            {
+                frequency[i] = 1;
+            }
+        }
+
+        close(inputFile);
+        return true;
+    }
+
+    unsigned char *buffer = malloc(READ_BUFFER_SIZE);
+    if(buffer == NULL)
+    {
+        printf("Memory Allocation Failed\n");
         exit(0);
     }
 
-    char buffer[MAXCHAR];
     ssize_t bytesRead;
 
     // read file in chunks and update frequencies of characters
-    while((bytesRead = read(inputFile, buffer, sizeof(buffer))) > 0)
+    while((bytesRead = read(inputFile, buffer, READ_BUFFER_SIZE)) > 0)
     {
-        for(ssize_t i = 0; i < bytesRead; ++i)
-        {
-            frequency[(unsigned char)buffer[i]]++;
-        }
+        kernels.countBytes(buffer, bytesRead, frequency);
     }
 
+    free(buffer);
     close(inputFile);
+
+    return true;
 }
 
 
@@ -265,467 +579,3438 @@ void PrintCodes(NODE *root, int array[], int top)
 
 
 
-// ** COMPRESSION CODE **
+// ** BWT / MTF / RLE TRANSFORM CODE **
 
-void GetCompressedFileName(char *inputFileName, char *compressedFileName)
+// find where each character's bucket starts (or ends) in the suffix array
+void GetBuckets(const int *text, int length, int alphabetSize, int *buckets, bool end)
 {
-    // Copy the input file name to the compressed file name buffer
-    strcpy(compressedFileName, inputFileName);
-
-    // Find the last occurrence of '.' in the input file name
-    char *dot = strrchr(compressedFileName, '.');
-
-    strcpy(dot, "_compressed.oats");
-}
+    memset(buckets, 0, alphabetSize * sizeof(int));
 
-// store huffman codes in a table to be used during compression
-void StoreCodes(NODE *root, int array[], int top, char *codes[MAXCHAR])
-{
-    // add 0 to huffman code
-    if(root->leftPtr)
+    for(int i = 0; i < length; ++i)
     {
-        array[top] = 0;
-        StoreCodes(root->leftPtr, array, top + 1, codes);
+        buckets[text[i]]++;
     }
 
-    // add 1 to huffman code
-    if(root->rightPtr)
+    int sum = 0;
+    for(int i = 0; i < alphabetSize; ++i)
     {
-        array[top] = 1;
-        StoreCodes(root->rightPtr, array, top + 1, codes);
+        sum += buckets[i];
+        buckets[i] = end ? sum : sum - buckets[i];
     }
+}
 
-    // see if current node is leaf (input character)
-    if(!root->leftPtr && !root->rightPtr)
-    {
-        //printf("Storing code for character: %c\n", root->character);
-        codes[(unsigned char)root->character] = malloc(top + 1);
+// see if suffix i is the leftmost of a run of S-type suffixes
+bool IsLMS(const bool *types, int i)
+{
+    return i > 0 && types[i] && !types[i - 1];
+}
 
-        // add huffman code into lookup table (array)
-        for(int i = 0; i < top; ++i)
+// sort L-type then S-type suffixes from the LMS suffixes already placed in the array
+void InduceSort(const int *text, int *suffixArray, const bool *types, int length, int alphabetSize, int *buckets)
+{
+    GetBuckets(text, length, alphabetSize, buckets, false);
+    for(int i = 0; i < length; ++i)
+    {
+        int j = suffixArray[i] - 1;
+        if(suffixArray[i] > 0 && !types[j])
         {
-            codes[(unsigned char)root->character][i] = array[i] + '0';
+            suffixArray[buckets[text[j]]++] = j;
         }
-
-        // add NULL
-        codes[(unsigned char)root->character][top] = '\0';
     }
-}
 
-void FreeCodes(char *codes[MAXCHAR])
-{
-    for(int i = 0; i < MAXCHAR; ++i)
+    GetBuckets(text, length, alphabetSize, buckets, true);
+    for(int i = length - 1; i >= 0; --i)
     {
-        if(codes[i])
+        int j = suffixArray[i] - 1;
+        if(suffixArray[i] > 0 && types[j])
         {
-            //printf("Freeing code for character: %c\n", (char)i);
-            free(codes[i]);
+            suffixArray[--buckets[text[j]]] = j;
         }
     }
 }
 
-// write huffman tree data into file for later decompression
-void WriteHuffmanTree(NODE *root, int outputFile)
+// linear time suffix array construction (SA-IS), text must end with a unique smallest 0
+void BuildSuffixArray(const int *text, int *suffixArray, int length, int alphabetSize)
 {
-    if (root == NULL) 
+    bool *types = malloc(length * sizeof(bool));
+    int *buckets = malloc(alphabetSize * sizeof(int));
+    if(types == NULL || buckets == NULL)
     {
-        return;
+        printf("Memory Allocation Failed\n");
+        exit(0);
     }
 
-    // see if current node is internal
-    if (root->leftPtr != NULL || root->rightPtr != NULL)
+    // S-type suffixes are smaller than the suffix after them, L-type ones are larger
+    types[length - 1] = true;
+    for(int i = length - 2; i >= 0; --i)
     {
-        char internalNode = '\0';
-        write(outputFile, &internalNode, sizeof(char));
+        types[i] = text[i] < text[i + 1] || (text[i] == text[i + 1] && types[i + 1]);
+    }
 
-        // recursively write the left and right pointers to the file
-        WriteHuffmanTree(root->leftPtr, outputFile);
-        WriteHuffmanTree(root->rightPtr, outputFile);
+    // step 1: place LMS suffixes at the end of their buckets and induce the rest
+    GetBuckets(text, length, alphabetSize, buckets, true);
+    for(int i = 0; i < length; ++i)
+    {
+        suffixArray[i] = -1;
     }
 
-    else
+    for(int i = 1; i < length; ++i)
     {
-        // write the character of the leaf node
-        write(outputFile, &(root->character), sizeof(char));
+        if(IsLMS(types, i))
+        {
+            suffixArray[--buckets[text[i]]] = i;
+        }
     }
-}
 
-// compress input file with huffman codes and write compressed data
-void CompressFile(const char *fileName, const char *outputFileName, NODE *root, char *codes[MAXCHAR])
-{
-    // input for read
-    int inputFile = open(fileName, O_RDONLY);
-    if(inputFile == -1)
+    InduceSort(text, suffixArray, types, length, alphabetSize, buckets);
+
+    // step 2: name the sorted LMS substrings
+    int lmsCount = 0;
+    for(int i = 0; i < length; ++i)
     {
-        printf("File failed to open.\n");
-        exit(0);
+        if(IsLMS(types, suffixArray[i]))
+        {
+            suffixArray[lmsCount++] = suffixArray[i];
+        }
     }
 
-    // output for write
-    int outputFile = open(outputFileName, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
-    if (outputFile == -1)
+    for(int i = lmsCount; i < length; ++i)
     {
-        printf("Output file failed to open.\n");
-        close(inputFile);
-        exit(0);
+        suffixArray[i] = -1;
     }
 
-    // write huffman tree to beginning of file
-    WriteHuffmanTree(root, outputFile);
+    int name = 0;
+    int previous = -1;
+    for(int i = 0; i < lmsCount; ++i)
+    {
+        int position = suffixArray[i];
+        bool different = false;
 
-    char buffer[MAXCHAR];
-    ssize_t bytesRead;
+        for(int d = 0; d < length; ++d)
+        {
+            if(previous == -1 || text[position + d] != text[previous + d] || types[position + d] != types[previous + d])
+            {
+                different = true;
+                break;
+            }
 
-    // store bits before writing to output
-    char bitBuffer = 0;
+            if(d > 0 && (IsLMS(types, position + d) || IsLMS(types, previous + d)))
+            {
+                break;
+            }
+        }
 
-    // track number of bits in the buffer
-    int bitCount = 0;
+        if(different)
+        {
+            name++;
+            previous = position;
+        }
 
-    // buffer for output to minimize write calls
-    char outputBuffer[MAXCHAR];
-    int outputBufferIndex = 0;
+        suffixArray[lmsCount + position / 2] = name - 1;
+    }
 
-    // read files in chunks
-    while ((bytesRead = read(inputFile, buffer, sizeof(buffer))) > 0)
+    for(int i = length - 1, j = length - 1; i >= lmsCount; --i)
     {
-        // process each byte
-        for (ssize_t i = 0; i < bytesRead; ++i)
+        if(suffixArray[i] >= 0)
         {
-            // find huffman code for the character
-            char *code = codes[(unsigned char)buffer[i]];
+            suffixArray[j--] = suffixArray[i];
+        }
+    }
 
-            // process each bit in the huffman code
-            for (int j = 0; code[j] != '\0'; ++j)
-            {
-                // add bit to the bit buffer
-                bitBuffer = (bitBuffer << 1) | (code[j] - '0');
-                bitCount++;
+    // step 3: sort the LMS suffixes by their names, recursing while names repeat
+    int *reduced = suffixArray + length - lmsCount;
 
-                // fill up outputBuffer
-                if (bitCount == 8)
-                {
-                    outputBuffer[outputBufferIndex++] = bitBuffer;
-                    bitBuffer = 0;
-                    bitCount = 0;
+    if(name < lmsCount)
+    {
+        BuildSuffixArray(reduced, suffixArray, lmsCount, name);
+    }
 
-                    // only write to output when outputBuffer is full
-                    if(outputBufferIndex == sizeof(outputBuffer))
-                    {
-                        write(outputFile, outputBuffer, sizeof(outputBuffer));
-                        outputBufferIndex = 0;
-                    }
-                }
-            }
+    else
+    {
+        for(int i = 0; i < lmsCount; ++i)
+        {
+            suffixArray[reduced[i]] = i;
         }
     }
 
-    // write rest of output buffer bytes
-    if (outputBufferIndex > 0)
+    // step 4: put the sorted LMS suffixes back in their buckets and induce the full order
+    for(int i = 1, j = 0; i < length; ++i)
     {
-        write(outputFile, outputBuffer, outputBufferIndex);
+        if(IsLMS(types, i))
+        {
+            reduced[j++] = i;
+        }
     }
 
-    // write leftover bits and pad them
-    if (bitCount > 0)
+    for(int i = 0; i < lmsCount; ++i)
     {
-        // shift bits left to fill byte
-        bitBuffer <<= (8 - bitCount);
-        write(outputFile, &bitBuffer, 1);
+        suffixArray[i] = reduced[suffixArray[i]];
     }
 
-    close(inputFile);
-    close(outputFile);
+    for(int i = lmsCount; i < length; ++i)
+    {
+        suffixArray[i] = -1;
+    }
+
+    GetBuckets(text, length, alphabetSize, buckets, true);
+    for(int i = lmsCount - 1; i >= 0; --i)
+    {
+        int j = suffixArray[i];
+        suffixArray[i] = -1;
+        suffixArray[--buckets[text[j]]] = j;
+    }
+
+    InduceSort(text, suffixArray, types, length, alphabetSize, buckets);
+
+    free(types);
+    free(buckets);
 }
 
-// see if file is valid for compression
-bool ASCII(char *inputFileName)
+// burrows-wheeler transform, move-to-front and zero run coding of one chunk
+// (output needs room for 2 * length symbols, returns how many were written)
+// rows gets the sorted row of the suffix starting at each chain's first character
+uint64_t TransformBlock(const unsigned char *data, uint64_t length, unsigned char *output, uint64_t rows[BWT_CHAINS])
 {
-    FILE *inputFile = fopen(inputFileName, "r");
-
-    if(inputFile == NULL)
+    // text with a unique smallest sentinel on the end
+    int *text = malloc((length + 1) * sizeof(int));
+    int *suffixArray = malloc((length + 1) * sizeof(int));
+    unsigned char *lastColumn = malloc(length);
+    if(text == NULL || suffixArray == NULL || lastColumn == NULL)
     {
-        printf("Error: input file failed to open.\n");
+        printf("Memory Allocation Failed\n");
         exit(0);
     }
 
-    int character;
+    for(uint64_t i = 0; i < length; ++i)
+    {
+        text[i] = data[i] + 1;
+    }
 
-    // loop through and check ASCII values of every character in file
-    while((character = fgetc(inputFile)) != EOF)
+    text[length] = 0;
+
+    BuildSuffixArray(text, suffixArray, length + 1, ALPHABET_SIZE + 1);
+
+    // last column of the sorted rotations, skipping the row that ends in the sentinel
+    uint64_t column = 0;
+    for(uint64_t i = 0; i <= length; ++i)
     {
-        if(character < 0 || character > 127)
+        for(int k = 0; k < BWT_CHAINS; ++k)
         {
-            fclose(inputFile);
-            return false;
+            if((uint64_t)suffixArray[i] == k * length / BWT_CHAINS)
+            {
+                rows[k] = i;
+            }
+        }
+
+        if(suffixArray[i] != 0)
+        {
+            lastColumn[column++] = data[suffixArray[i] - 1];
         }
     }
 
-    fclose(inputFile);
+    // move-to-front turns repeated characters into runs of zeros
+    unsigned char order[ALPHABET_SIZE];
+    for(int i = 0; i < ALPHABET_SIZE; ++i)
+    {
+        order[i] = i;
+    }
+
+    uint64_t symbolCount = 0;
+    uint64_t zeroRun = 0;
+
+    for(uint64_t i = 0; i < length; ++i)
+    {
+        unsigned char character = lastColumn[i];
+        int rank = 0;
+        while(order[rank] != character)
+        {
+            rank++;
+        }
+
+        memmove(order + 1, order, rank);
+        order[0] = character;
+
+        // zero runs are written as a zero followed by the run length minus one
+        if(rank == 0)
+        {
+            zeroRun++;
+        }
+
+        if(zeroRun > 0 && (rank != 0 || zeroRun == 256 || i == length - 1))
+        {
+            output[symbolCount++] = 0;
+            output[symbolCount++] = zeroRun - 1;
+            zeroRun = 0;
+        }
+
+        if(rank != 0)
+        {
+            output[symbolCount++] = rank;
+        }
+    }
+
+    free(text);
+    free(suffixArray);
+    free(lastColumn);
+
+    return symbolCount;
+}
+
+// undo zero run coding, move-to-front and the burrows-wheeler transform
+bool UndoTransform(const unsigned char *symbols, uint64_t symbolCount, const uint64_t rows[BWT_CHAINS], unsigned char *output, uint64_t length)
+{
+    for(int k = 0; k < BWT_CHAINS; ++k)
+    {
+        if(rows[k] > length)
+        {
+            return false;
+        }
+    }
+
+    // the row holding the whole chunk ends in the sentinel
+    uint64_t primary = rows[0];
+
+    unsigned char *lastColumn = malloc(length);
+    uint32_t *next = malloc((length + 1) * sizeof(uint32_t));
+    if(lastColumn == NULL || next == NULL)
+    {
+        printf("Memory Allocation Failed\n");
+        exit(0);
+    }
+
+    unsigned char order[ALPHABET_SIZE];
+    for(int i = 0; i < ALPHABET_SIZE; ++i)
+    {
+        order[i] = i;
+    }
+
+    // expand zero runs and move-to-front ranks back into the last column
+    uint64_t column = 0;
+    bool valid = true;
+
+    for(uint64_t i = 0; i < symbolCount && valid; ++i)
+    {
+        uint64_t run = 1;
+        int rank = symbols[i];
+
+        if(rank == 0)
+        {
+            valid = i + 1 < symbolCount;
+            run = valid ? symbols[++i] + 1 : 0;
+        }
+
+        if(column + run > length)
+        {
+            valid = false;
+            break;
+        }
+
+        unsigned char character = order[rank];
+        memmove(order + 1, order, rank);
+        order[0] = character;
+
+        memset(lastColumn + column, character, run);
+        column += run;
+    }
+
+    if(!valid || column != length)
+    {
+        free(lastColumn);
+        free(next);
+        return false;
+    }
+
+    // rows are sorted, so each character's rows start after every smaller character (and the sentinel)
+    uint64_t start[ALPHABET_SIZE] = {0};
+    for(uint64_t i = 0; i < length; ++i)
+    {
+        start[lastColumn[i]]++;
+    }
+
+    uint64_t sum = 1;
+    for(int i = 0; i < ALPHABET_SIZE; ++i)
+    {
+        uint64_t count = start[i];
+        start[i] = sum;
+        sum += count;
+    }
+
+    // map each row to the row starting one character earlier in the text,
+    // packed with the row's last character so each step is a single load
+    for(uint64_t row = 0, i = 0; row <= length; ++row)
+    {
+        if(row == primary)
+        {
+            next[row] = 0;
+        }
+
+        else
+        {
+            unsigned char character = lastColumn[i++];
+            next[row] = (start[character]++ << 8) | character;
+        }
+    }
+
+    // walk the chunk backwards as independent chains so their cache misses overlap,
+    // each chain starts at the row of the next chain's first suffix (the last at the sentinel row)
+    uint64_t chainRow[BWT_CHAINS];
+    uint64_t chainStart[BWT_CHAINS];
+    uint64_t chainPosition[BWT_CHAINS];
+
+    for(int k = 0; k < BWT_CHAINS; ++k)
+    {
+        chainStart[k] = k * length / BWT_CHAINS;
+        chainPosition[k] = k + 1 < BWT_CHAINS ? (k + 1) * length / BWT_CHAINS : length;
+        chainRow[k] = k + 1 < BWT_CHAINS ? rows[k + 1] : 0;
+    }
+
+    bool walking = true;
+    while(walking && valid)
+    {
+        walking = false;
+
+        for(int k = 0; k < BWT_CHAINS; ++k)
+        {
+            if(chainPosition[k] > chainStart[k])
+            {
+                if(chainRow[k] == primary)
+                {
+                    valid = false;
+                }
+
+                uint32_t step = next[chainRow[k]];
+                output[--chainPosition[k]] = step & 0xFF;
+                chainRow[k] = step >> 8;
+                walking = true;
+            }
+        }
+    }
+
+    free(lastColumn);
+    free(next);
+
+    return valid;
+}
+
+
+
+
+
+
+// ** COMPRESSION CODE **
+
+void GetCompressedFileName(char *inputFileName, char *compressedFileName)
+{
+    // Copy the input file name to the compressed file name buffer
+    strcpy(compressedFileName, inputFileName);
+
+    // Find the last occurrence of '.' in the input file name
+    char *dot = strrchr(compressedFileName, '.');
+
+    strcpy(dot, "_compressed.oats");
+}
+
+// store huffman codes in a table to be used during compression
+void StoreCodes(NODE *root, int array[], int top, char *codes[MAXCHAR])
+{
+    // add 0 to huffman code
+    if(root->leftPtr)
+    {
+        array[top] = 0;
+        StoreCodes(root->leftPtr, array, top + 1, codes);
+    }
+
+    // add 1 to huffman code
+    if(root->rightPtr)
+    {
+        array[top] = 1;
+        StoreCodes(root->rightPtr, array, top + 1, codes);
+    }
+
+    // see if current node is leaf (input character)
+    if(!root->leftPtr && !root->rightPtr)
+    {
+        //printf("Storing code for character: %c\n", root->character);
+        codes[(unsigned char)root->character] = malloc(top + 1);
+
+        // add huffman code into lookup table (array)
+        for(int i = 0; i < top; ++i)
+        {
+            codes[(unsigned char)root->character][i] = array[i] + '0';
+        }
+
+        // add NULL
+        codes[(unsigned char)root->character][top] = '\0';
+    }
+}
+
+void FreeCodes(char *codes[MAXCHAR])
+{
+    for(int i = 0; i < MAXCHAR; ++i)
+    {
+        if(codes[i])
+        {
+            //printf("Freeing code for character: %c\n", (char)i);
+            free(codes[i]);
+        }
+    }
+}
+
+// write huffman tree data into file for later decompression (leaves hold symbolBytes byte symbols)
+bool WriteHuffmanTree(NODE *root, int outputFile, int symbolBytes)
+{
+    if (root == NULL) 
+    {
+        return true;
+    }
+
+    // see if current node is internal
+    if (root->leftPtr != NULL || root->rightPtr != NULL)
+    {
+        char internalNode = TREE_INTERNAL;
+        if(write(outputFile, &internalNode, sizeof(char)) != sizeof(char))
+        {
+            return false;
+        }
+
+        // recursively write the left and right pointers to the file
+        return WriteHuffmanTree(root->leftPtr, outputFile, symbolBytes) &&
+               WriteHuffmanTree(root->rightPtr, outputFile, symbolBytes);
+    }
+
+    else
+    {
+        // tag leaves so '\0' can be stored as a character
+        char leafNode = TREE_LEAF;
+        if(write(outputFile, &leafNode, sizeof(char)) != sizeof(char))
+        {
+            return false;
+        }
+
+        // write the character of the leaf node (low byte first)
+        unsigned char symbol[sizeof(uint16_t)] = {root->character & 0xFF, root->character >> 8};
+        return write(outputFile, symbol, symbolBytes) == symbolBytes;
+    }
+}
+
+// turn string codes into bit patterns for the encode kernel
+void BuildCodeWords(char *codes[MAXCHAR], CODEWORD codeWords[ALPHABET_SIZE])
+{
+    for(int c = 0; c < ALPHABET_SIZE; ++c)
+    {
+        codeWords[c].bits = 0;
+        codeWords[c].length = 0;
+
+        for(int j = 0; codes[c] != NULL && codes[c][j] != '\0'; ++j)
+        {
+            codeWords[c].bits = (codeWords[c].bits << 1) | (codes[c][j] - '0');
+            codeWords[c].length++;
+        }
+    }
+}
+
+// code words straight from the tree, for alphabets too large for string codes
+void StoreCodeWords(NODE *root, uint64_t bits, int depth, CODEWORD codeWords[])
+{
+    if(!root->leftPtr && !root->rightPtr)
+    {
+        codeWords[root->character].bits = bits;
+        codeWords[root->character].length = depth;
+        return;
+    }
+
+    StoreCodeWords(root->leftPtr, bits << 1, depth + 1, codeWords);
+    StoreCodeWords(root->rightPtr, (bits << 1) | 1, depth + 1, codeWords);
+}
+
+// add the codes of count one or two byte symbols to the writer (codes are at most 56 bits)
+KERNEL_BODY void EncodeSymbolsBody(BITWRITER *writer, const void *symbols, uint64_t count, const CODEWORD codeWords[], int symbolBytes)
+{
+    uint64_t bitBuffer = writer->bitBuffer;
+    int bitCount = writer->bitCount;
+    int index = writer->outputBufferIndex;
+
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        int symbol = symbolBytes == 1 ? ((const unsigned char *)symbols)[i] : ((const uint16_t *)symbols)[i];
+        const CODEWORD *code = &codeWords[symbol];
+        bitBuffer = (bitBuffer << code->length) | code->bits;
+        bitCount += code->length;
+
+        // move every whole byte to outputBuffer
+        while(bitCount >= 8)
+        {
+            bitCount -= 8;
+            writer->outputBuffer[index++] = bitBuffer >> bitCount;
+
+            // only write to output when outputBuffer is full
+            if(index == sizeof(writer->outputBuffer))
+            {
+                // a short write (disk full, file size limit) is reported when the block is done
+                writer->failed |= write(writer->outputFile, writer->outputBuffer, sizeof(writer->outputBuffer)) != sizeof(writer->outputBuffer);
+                index = 0;
+            }
+        }
+    }
+
+    writer->bitBuffer = bitBuffer;
+    writer->bitCount = bitCount;
+    writer->outputBufferIndex = index;
+}
+
+void EncodeSymbolsScalar(BITWRITER *writer, const unsigned char *symbols, uint64_t count, const CODEWORD codeWords[])
+{
+    EncodeSymbolsBody(writer, symbols, count, codeWords, sizeof(char));
+}
+
+// token symbols are encoded by the same loop
+void EncodeTokens(BITWRITER *writer, const uint16_t *symbols, uint64_t count, const CODEWORD codeWords[])
+{
+    EncodeSymbolsBody(writer, symbols, count, codeWords, sizeof(uint16_t));
+}
+
+#ifdef KERNEL_DISPATCH
+TARGET_SSE42 void EncodeSymbolsSSE42(BITWRITER *writer, const unsigned char *symbols, uint64_t count, const CODEWORD codeWords[])
+{
+    EncodeSymbolsBody(writer, symbols, count, codeWords, sizeof(char));
+}
+
+TARGET_AVX2 void EncodeSymbolsAVX2(BITWRITER *writer, const unsigned char *symbols, uint64_t count, const CODEWORD codeWords[])
+{
+    EncodeSymbolsBody(writer, symbols, count, codeWords, sizeof(char));
+}
+#endif
+
+// pad leftover bits to a full byte and write everything buffered
+void FlushBits(BITWRITER *writer)
+{
+    // shift bits left to fill byte
+    if (writer->bitCount > 0)
+    {
+        writer->outputBuffer[writer->outputBufferIndex++] = writer->bitBuffer << (8 - writer->bitCount);
+        writer->bitBuffer = 0;
+        writer->bitCount = 0;
+    }
+
+    // write rest of output buffer bytes
+    if (writer->outputBufferIndex > 0)
+    {
+        writer->failed |= write(writer->outputFile, writer->outputBuffer, writer->outputBufferIndex) != writer->outputBufferIndex;
+        writer->outputBufferIndex = 0;
+    }
+}
+
+// code symbols into a new block at the current position of outputFile (rows is NULL for untransformed data,
+// root is NULL when the codes come from a solid archive's shared tree)
+bool WriteBlock(int outputFile, const unsigned char *symbols, uint64_t symbolCount, NODE *root, char *codes[MAXCHAR], const uint64_t *rows, INDEXENTRY *entry)
+{
+    entry->offset = lseek(outputFile, 0, SEEK_CUR);
+
+    // every block carries its own coding mode and huffman tree
+    char mode = BLOCK_HUFFMAN;
+    if(symbolCount >= STREAM_THRESHOLD)
+    {
+        mode |= BLOCK_FOURSTREAMS;
+    }
+
+    if(rows != NULL)
+    {
+        mode |= BLOCK_BWT;
+    }
+
+    if(root == NULL)
+    {
+        mode |= BLOCK_SHAREDTREE;
+    }
+
+    bool written = write(outputFile, &mode, sizeof(char)) == sizeof(char) &&
+                   WriteHuffmanTree(root, outputFile, sizeof(char));
+
+    // transformed blocks record how many symbols were coded and where each inverse chain starts
+    if(mode & BLOCK_BWT)
+    {
+        written = written &&
+                  write(outputFile, &symbolCount, sizeof(symbolCount)) == sizeof(symbolCount) &&
+                  write(outputFile, rows, BWT_CHAINS * sizeof(uint64_t)) == BWT_CHAINS * sizeof(uint64_t);
+    }
+
+    // jump table: characters per stream, then byte length of every stream but the last
+    uint64_t jumpTable[STREAM_COUNT] = {0};
+    off_t jumpTableOffset = lseek(outputFile, 0, SEEK_CUR);
+    uint64_t boundary = UINT64_MAX;
+    int stream = 0;
+
+    if(mode & BLOCK_FOURSTREAMS)
+    {
+        jumpTable[0] = symbolCount / STREAM_COUNT;
+        boundary = jumpTable[0];
+        written = written && write(outputFile, jumpTable, sizeof(jumpTable)) == sizeof(jumpTable);
+    }
+
+    off_t streamStart = lseek(outputFile, 0, SEEK_CUR);
+
+    CODEWORD codeWords[ALPHABET_SIZE];
+    BuildCodeWords(codes, codeWords);
+
+    BITWRITER writer = {outputFile, 0, 0, {0}, 0, false};
+    uint64_t start = 0;
+
+    // each stream starts on its own byte
+    while (boundary != UINT64_MAX)
+    {
+        kernels.encodeSymbols(&writer, symbols + start, boundary - start, codeWords);
+        FlushBits(&writer);
+
+        off_t streamEnd = lseek(outputFile, 0, SEEK_CUR);
+        jumpTable[++stream] = streamEnd - streamStart;
+        streamStart = streamEnd;
+        start = boundary;
+        boundary = stream < STREAM_COUNT - 1 ? boundary + jumpTable[0] : UINT64_MAX;
+    }
+
+    // last (or only) stream takes the rest of the symbols
+    kernels.encodeSymbols(&writer, symbols + start, symbolCount - start, codeWords);
+    FlushBits(&writer);
+
+    if(mode & BLOCK_FOURSTREAMS)
+    {
+        written = written && pwrite(outputFile, jumpTable, sizeof(jumpTable), jumpTableOffset) == sizeof(jumpTable);
+    }
+
+    entry->length = lseek(outputFile, 0, SEEK_CUR) - entry->offset;
+    return written && !writer.failed;
+}
+
+// map a whole file for reading, only what it held when we started (NULL if empty or on failure)
+const unsigned char* MapFile(int file, uint64_t *size)
+{
+    struct stat fileInfo;
+    if(fstat(file, &fileInfo) == -1 || fileInfo.st_size == 0)
+    {
+        return NULL;
+    }
+
+    *size = fileInfo.st_size;
+
+    const unsigned char *data = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, file, 0);
+    return data == MAP_FAILED ? NULL : data;
+}
+
+// write the block index and index magic at the current position of outputFile
+bool WriteIndex(int outputFile, INDEXENTRY *entries, uint64_t count)
+{
+    return write(outputFile, entries, count * sizeof(INDEXENTRY)) == (ssize_t)(count * sizeof(INDEXENTRY)) &&
+           write(outputFile, &count, sizeof(count)) == sizeof(count) &&
+           write(outputFile, INDEX_MAGIC, MAGIC_LENGTH) == MAGIC_LENGTH;
+}
+
+// read the trailing index of an archive (NULL if the file has no valid index),
+// fileTableOffset is where a solid archive's file table starts (-1 for other archives)
+INDEXENTRY* ReadIndex(int inputFile, uint64_t *count, off_t *indexOffset, off_t *fileTableOffset)
+{
+    struct stat fileInfo;
+    if(fstat(inputFile, &fileInfo) == -1)
+    {
+        return NULL;
+    }
+
+    // archive must at least hold the header, block count and index magic
+    off_t trailerSize = sizeof(uint64_t) + MAGIC_LENGTH;
+    if(fileInfo.st_size < MAGIC_LENGTH + trailerSize)
+    {
+        return NULL;
+    }
+
+    char magic[MAGIC_LENGTH];
+    if(pread(inputFile, magic, MAGIC_LENGTH, 0) != MAGIC_LENGTH ||
+    memcmp(magic, ARCHIVE_MAGIC, MAGIC_LENGTH) != 0)
+    {
+        return NULL;
+    }
+
+    off_t trailerOffset = fileInfo.st_size - trailerSize;
+    if(pread(inputFile, count, sizeof(uint64_t), trailerOffset) != sizeof(uint64_t) ||
+    pread(inputFile, magic, MAGIC_LENGTH, trailerOffset + sizeof(uint64_t)) != MAGIC_LENGTH)
+    {
+        return NULL;
+    }
+
+    // index ends at the trailer, or at the file table of a solid archive
+    off_t indexEnd = trailerOffset;
+    *fileTableOffset = -1;
+
+    if(memcmp(magic, SOLID_MAGIC, MAGIC_LENGTH) == 0)
+    {
+        uint64_t tableOffset;
+        if(trailerOffset < MAGIC_LENGTH + (off_t)sizeof(uint64_t) ||
+        pread(inputFile, &tableOffset, sizeof(uint64_t), trailerOffset - sizeof(uint64_t)) != sizeof(uint64_t) ||
+        tableOffset < MAGIC_LENGTH || tableOffset > (uint64_t)trailerOffset - sizeof(uint64_t))
+        {
+            return NULL;
+        }
+
+        *fileTableOffset = tableOffset;
+        indexEnd = tableOffset;
+    }
+
+    else if(memcmp(magic, INDEX_MAGIC, MAGIC_LENGTH) != 0)
+    {
+        return NULL;
+    }
+
+    // make sure the index fits between the header and the trailer
+    if(*count > (uint64_t)(indexEnd - MAGIC_LENGTH) / sizeof(INDEXENTRY))
+    {
+        return NULL;
+    }
+
+    *indexOffset = indexEnd - *count * sizeof(INDEXENTRY);
+
+    // extra slot so an appended block can be added without reallocating
+    INDEXENTRY *entries = malloc((*count + 1) * sizeof(INDEXENTRY));
+    if(entries == NULL)
+    {
+        printf("Memory Allocation Failed\n");
+        exit(0);
+    }
+
+    ssize_t indexSize = *count * sizeof(INDEXENTRY);
+    if(pread(inputFile, entries, indexSize, *indexOffset) != indexSize)
+    {
+        free(entries);
+        return NULL;
+    }
+
+    return entries;
+}
+
+// compress input file with huffman codes and write compressed data
+bool CompressFile(const char *fileName, const char *outputFileName, NODE *root, char *codes[MAXCHAR])
+{
+    // input for read
+    int inputFile = open(fileName, O_RDONLY);
+    if(inputFile == -1)
+    {
+        printf("File failed to open.\n");
+        return false;
+    }
+
+    // output for write
+    int outputFile = open(outputFileName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (outputFile == -1)
+    {
+        printf("Output file failed to open.\n");
+        close(inputFile);
+        return false;
+    }
+
+    uint64_t size;
+    const unsigned char *data = MapFile(inputFile, &size);
+    if(data == NULL)
+    {
+        printf("File failed to map.\n");
+        close(inputFile);
+        close(outputFile);
+        return false;
+    }
+
+    // new archive holding a single block
+    INDEXENTRY entry;
+    write(outputFile, ARCHIVE_MAGIC, MAGIC_LENGTH);
+    WriteBlock(outputFile, data, size, root, codes, NULL, &entry);
+    entry.originalSize = size;
+    WriteIndex(outputFile, &entry, 1);
+
+    munmap((void *)data, size);
+    close(inputFile);
+    close(outputFile);
+
+    return true;
+}
+
+// add input file as a new block to an existing archive without touching older blocks
+bool AppendFile(const char *fileName, const char *archiveFileName, NODE *root, char *codes[MAXCHAR])
+{
+    // nothing to append to yet
+    if(access(archiveFileName, F_OK) != 0)
+    {
+        return CompressFile(fileName, archiveFileName, root, codes);
+    }
+
+    // input for read
+    int inputFile = open(fileName, O_RDONLY);
+    if(inputFile == -1)
+    {
+        printf("File failed to open.\n");
+        return false;
+    }
+
+    // archive for read and write
+    int archiveFile = open(archiveFileName, O_RDWR);
+    if (archiveFile == -1)
+    {
+        printf("Archive file failed to open.\n");
+        close(inputFile);
+        return false;
+    }
+
+    uint64_t count;
+    off_t indexOffset;
+    off_t fileTableOffset;
+    INDEXENTRY *entries = ReadIndex(archiveFile, &count, &indexOffset, &fileTableOffset);
+
+    if(entries == NULL || fileTableOffset >= 0)
+    {
+        printf("Error: can't append to this file (not an archive, a solid archive or it is encrypted).\n");
+        free(entries);
+        close(inputFile);
+        close(archiveFile);
+        return false;
+    }
+
+    uint64_t size;
+    const unsigned char *data = MapFile(inputFile, &size);
+    if(data == NULL)
+    {
+        printf("File failed to map.\n");
+        free(entries);
+        close(inputFile);
+        close(archiveFile);
+        return false;
+    }
+
+    // new block replaces the old index, which is rewritten after it
+    lseek(archiveFile, indexOffset, SEEK_SET);
+    bool appended = WriteBlock(archiveFile, data, size, root, codes, NULL, &entries[count]);
+    entries[count].originalSize = size;
+    appended = appended &&
+               WriteIndex(archiveFile, entries, count + 1) &&
+               ftruncate(archiveFile, lseek(archiveFile, 0, SEEK_CUR)) == 0;
+
+    // a failed write would leave a half block and no index, so put the old index back
+    if(!appended)
+    {
+        ftruncate(archiveFile, indexOffset);
+        lseek(archiveFile, indexOffset, SEEK_SET);
+        WriteIndex(archiveFile, entries, count);
+        printf("Error: failed to write to the archive, nothing was appended.\n");
+    }
+
+    munmap((void *)data, size);
+    free(entries);
+    close(inputFile);
+    close(archiveFile);
+
+    return appended;
+}
+
+// compress a file as independently transformed chunks, each with its own huffman tree
+bool CompressTransformedFile(const char *fileName, const char *outputFileName)
+{
+    // input for read
+    int inputFile = open(fileName, O_RDONLY);
+    if(inputFile == -1)
+    {
+        printf("File failed to open.\n");
+        return false;
+    }
+
+    uint64_t size;
+    const unsigned char *data = MapFile(inputFile, &size);
+    if(data == NULL)
+    {
+        printf("File failed to map.\n");
+        close(inputFile);
+        return false;
+    }
+
+    // output for write
+    int outputFile = open(outputFileName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (outputFile == -1)
+    {
+        printf("Output file failed to open.\n");
+        munmap((void *)data, size);
+        close(inputFile);
+        return false;
+    }
+
+    uint64_t count = (size + BWT_BLOCK_SIZE - 1) / BWT_BLOCK_SIZE;
+    INDEXENTRY *entries = malloc(count * sizeof(INDEXENTRY));
+    unsigned char *symbols = malloc(2 * BWT_BLOCK_SIZE);
+    if(entries == NULL || symbols == NULL)
+    {
+        printf("Memory Allocation Failed\n");
+        exit(0);
+    }
+
+    write(outputFile, ARCHIVE_MAGIC, MAGIC_LENGTH);
+
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t offset = i * BWT_BLOCK_SIZE;
+        uint64_t length = size - offset < BWT_BLOCK_SIZE ? size - offset : BWT_BLOCK_SIZE;
+
+        uint64_t rows[BWT_CHAINS];
+        uint64_t symbolCount = TransformBlock(data + offset, length, symbols, rows);
+
+        // step 1: Calculate frequency of each transformed symbol
+        int frequency[MAXCHAR] = {0};
+        kernels.countBytes(symbols, symbolCount, frequency);
+
+        // step 2-4: Build min heap, Huffman tree and codes
+        MINHEAP *minHeap = BuildMinHeap(frequency, MAXCHAR);
+        NODE *root = BuildHuffmanTree(minHeap);
+
+        char *codes[MAXCHAR] = {0};
+        int array[MAXCHAR], top = 0;
+        StoreCodes(root, array, top, codes);
+
+        // step 5: write the chunk as its own block
+        WriteBlock(outputFile, symbols, symbolCount, root, codes, rows, &entries[i]);
+        entries[i].originalSize = length;
+
+        // free dynamic memory
+        FreeCodes(codes);
+        FreeHuffmanTree(root);
+        FreeMinHeap(minHeap);
+    }
+
+    WriteIndex(outputFile, entries, count);
+
+    free(entries);
+    free(symbols);
+    munmap((void *)data, size);
+    close(inputFile);
+    close(outputFile);
+
+    return true;
+}
+
+// fast content hash used to find duplicate files (eight bytes per step)
+uint64_t HashContent(const unsigned char *data, uint64_t size)
+{
+    uint64_t hash = 14695981039346656037ULL ^ size;
+    uint64_t i = 0;
+
+    for(; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+        hash ^= hash >> 32;
+    }
+
+    for(; i < size; ++i)
+    {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+// count a solid archive member's characters in slices small enough for the counting kernel
+void CountMemberBytes(SOLIDMEMBER *member)
+{
+    int frequency[MAXCHAR];
+
+    for(uint64_t offset = 0; offset < member->size; offset += READ_BUFFER_SIZE)
+    {
+        uint64_t length = member->size - offset < READ_BUFFER_SIZE ? member->size - offset : READ_BUFFER_SIZE;
+
+        memset(frequency, 0, sizeof(frequency));
+        kernels.countBytes(member->data + offset, length, frequency);
+
+        for(int i = 0; i < ALPHABET_SIZE; ++i)
+        {
+            member->frequency[i] += frequency[i];
+        }
+    }
+}
+
+// scale 64 bit counts so tree frequencies still fit in an int (every character present keeps a count)
+void ScaleFrequency(const uint64_t counts[ALPHABET_SIZE], uint64_t total, int frequency[MAXCHAR])
+{
+    uint64_t divisor = total / (INT_MAX / 2) + 1;
+    memset(frequency, 0, MAXCHAR * sizeof(int));
+
+    for(int i = 0; i < ALPHABET_SIZE; ++i)
+    {
+        if(counts[i] > 0)
+        {
+            frequency[i] = counts[i] / divisor > 0 ? counts[i] / divisor : 1;
+        }
+    }
+}
+
+// total bits needed to code a histogram with a set of codes
+uint64_t CodedBits(const uint64_t frequency[ALPHABET_SIZE], char *codes[MAXCHAR])
+{
+    uint64_t bits = 0;
+
+    for(int i = 0; i < ALPHABET_SIZE; ++i)
+    {
+        if(frequency[i] > 0)
+        {
+            bits += frequency[i] * strlen(codes[i]);
+        }
+    }
+
+    return bits;
+}
+
+// member names must stay below the archive's directory (relative, no ".." part)
+bool MemberNameSafe(const char *name)
+{
+    if(name[0] == '/')
+    {
+        return false;
+    }
+
+    for(const char *part = name; part != NULL; part = strchr(part, '/'))
+    {
+        part += *part == '/';
+        if(strncmp(part, "..", 2) == 0 && (part[2] == '/' || part[2] == '\0'))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// pack every file listed (one per line) in listFileName into one solid archive
+bool PackSolidArchive(const char *listFileName, const char *outputFileName)
+{
+    FILE *listFile = fopen(listFileName, "r");
+    if(listFile == NULL)
+    {
+        printf("File failed to open.\n");
+        return false;
+    }
+
+    SOLIDMEMBER *members = NULL;
+    uint64_t memberCount = 0;
+    uint64_t capacity = 0;
+    char line[500];
+    bool valid = true;
+
+    // step 1: map, hash and count every listed file, spotting exact duplicates
+    while(valid && fgets(line, sizeof(line), listFile) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if(line[0] == '\0')
+        {
+            continue;
+        }
+
+        if(memberCount == capacity)
+        {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            members = realloc(members, capacity * sizeof(SOLIDMEMBER));
+            if(members == NULL)
+            {
+                printf("Memory Allocation Failed\n");
+                exit(0);
+            }
+        }
+
+        SOLIDMEMBER *member = &members[memberCount];
+        memset(member, 0, sizeof(SOLIDMEMBER));
+        strcpy(member->name, line);
+        member->duplicateOf = memberCount;
+        member->block = NO_BLOCK;
+
+        if(!MemberNameSafe(member->name))
+        {
+            printf("Error: %s must be a relative path without \"..\".\n", member->name);
+            valid = false;
+            break;
+        }
+
+        int inputFile = open(member->name, O_RDONLY);
+        if(inputFile == -1)
+        {
+            printf("Error: %s failed to open.\n", member->name);
+            valid = false;
+            break;
+        }
+
+        // only regular files can be mapped, and empty ones have no mapping and no block
+        struct stat fileInfo;
+        if(fstat(inputFile, &fileInfo) == -1 || !S_ISREG(fileInfo.st_mode))
+        {
+            printf("Error: %s is not a regular file.\n", member->name);
+            close(inputFile);
+            valid = false;
+            break;
+        }
+
+        memberCount++;
+
+        if(fileInfo.st_size == 0)
+        {
+            close(inputFile);
+            continue;
+        }
+
+        member->data = MapFile(inputFile, &member->size);
+        close(inputFile);
+
+        if(member->data == NULL)
+        {
+            printf("Error: %s failed to map.\n", member->name);
+            valid = false;
+            break;
+        }
+
+        member->hash = HashContent(member->data, member->size);
+
+        for(uint64_t i = 0; i < memberCount - 1; ++i)
+        {
+            if(members[i].duplicateOf == i && members[i].size == member->size && members[i].hash == member->hash &&
+            memcmp(members[i].data, member->data, member->size) == 0)
+            {
+                member->duplicateOf = i;
+                break;
+            }
+        }
+
+        if(member->duplicateOf != memberCount - 1)
+        {
+            continue;
+        }
+
+        CountMemberBytes(member);
+
+        // only compress files with ASCII values
+        for(int i = 128; i < ALPHABET_SIZE; ++i)
+        {
+            if(member->frequency[i] > 0)
+            {
+                printf("Error: can't compress %s.\n", member->name);
+                valid = false;
+                break;
+            }
+        }
+    }
+
+    fclose(listFile);
+
+    int outputFile = -1;
+    if(valid)
+    {
+        outputFile = open(outputFileName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        if(outputFile == -1)
+        {
+            printf("Output file failed to open.\n");
+            valid = false;
+        }
+    }
+
+    if(valid)
+    {
+        // step 2: one shared tree covering every character of every unique file
+        uint64_t combined[MAXCHAR] = {0};
+        uint64_t total = 0;
+
+        for(uint64_t i = 0; i < memberCount; ++i)
+        {
+            if(members[i].duplicateOf == i && members[i].size > 0)
+            {
+                for(int j = 0; j < ALPHABET_SIZE; ++j)
+                {
+                    combined[j] += members[i].frequency[j];
+                }
+
+                total += members[i].size;
+            }
+        }
+
+        int sharedFrequency[MAXCHAR];
+        ScaleFrequency(combined, total, sharedFrequency);
+        bool anyData = total > 0;
+
+        MINHEAP *sharedHeap = NULL;
+        NODE *sharedRoot = NULL;
+        char *sharedCodes[MAXCHAR] = {0};
+        int array[MAXCHAR], top = 0;
+
+        // shared tree sits right after the header
+        write(outputFile, ARCHIVE_MAGIC, MAGIC_LENGTH);
+
+        if(anyData)
+        {
+            sharedHeap = BuildMinHeap(sharedFrequency, MAXCHAR);
+            sharedRoot = BuildHuffmanTree(sharedHeap);
+            StoreCodes(sharedRoot, array, top, sharedCodes);
+            WriteHuffmanTree(sharedRoot, outputFile, sizeof(char));
+        }
+
+        // step 3: one block per unique file, with its own tree only when that is smaller
+        INDEXENTRY *entries = malloc((memberCount + 1) * sizeof(INDEXENTRY));
+        if(entries == NULL)
+        {
+            printf("Memory Allocation Failed\n");
+            exit(0);
+        }
+
+        uint64_t blockCount = 0;
+
+        for(uint64_t i = 0; i < memberCount; ++i)
+        {
+            SOLIDMEMBER *member = &members[i];
+
+            if(member->duplicateOf != i)
+            {
+                member->block = members[member->duplicateOf].block;
+                continue;
+            }
+
+            if(member->size == 0)
+            {
+                continue;
+            }
+
+            int frequency[MAXCHAR];
+            ScaleFrequency(member->frequency, member->size, frequency);
+
+            MINHEAP *minHeap = BuildMinHeap(frequency, MAXCHAR);
+            NODE *root = BuildHuffmanTree(minHeap);
+            char *codes[MAXCHAR] = {0};
+            StoreCodes(root, array, top, codes);
+
+            // a tree costs a tag per node plus a byte per leaf
+            int leaves = 0;
+            for(int j = 0; j < ALPHABET_SIZE; ++j)
+            {
+                leaves += member->frequency[j] > 0;
+            }
+
+            uint64_t ownBits = CodedBits(member->frequency, codes) + 8 * (3 * leaves - 1);
+            uint64_t sharedBits = CodedBits(member->frequency, sharedCodes);
+
+            if(sharedBits <= ownBits)
+            {
+                WriteBlock(outputFile, member->data, member->size, NULL, sharedCodes, NULL, &entries[blockCount]);
+            }
+
+            else
+            {
+                WriteBlock(outputFile, member->data, member->size, root, codes, NULL, &entries[blockCount]);
+            }
+
+            entries[blockCount].originalSize = member->size;
+            member->block = blockCount++;
+
+            // free dynamic memory
+            FreeCodes(codes);
+            FreeHuffmanTree(root);
+            FreeMinHeap(minHeap);
+        }
+
+        // step 4: index, file table and trailer
+        write(outputFile, entries, blockCount * sizeof(INDEXENTRY));
+
+        uint64_t fileTableOffset = lseek(outputFile, 0, SEEK_CUR);
+
+        for(uint64_t i = 0; i < memberCount; ++i)
+        {
+            uint16_t nameLength = strlen(members[i].name);
+            write(outputFile, &members[i].size, sizeof(uint64_t));
+            write(outputFile, &members[i].block, sizeof(uint64_t));
+            write(outputFile, &nameLength, sizeof(nameLength));
+            write(outputFile, members[i].name, nameLength);
+        }
+
+        write(outputFile, &fileTableOffset, sizeof(fileTableOffset));
+        write(outputFile, &blockCount, sizeof(blockCount));
+        write(outputFile, SOLID_MAGIC, MAGIC_LENGTH);
+
+        free(entries);
+        FreeCodes(sharedCodes);
+        FreeHuffmanTree(sharedRoot);
+        if(sharedHeap != NULL)
+        {
+            FreeMinHeap(sharedHeap);
+        }
+
+        close(outputFile);
+    }
+
+    for(uint64_t i = 0; i < memberCount; ++i)
+    {
+        if(members[i].data != NULL)
+        {
+            munmap((void *)members[i].data, members[i].size);
+        }
+    }
+
+    free(members);
+
+    return valid;
+}
+
+// see if a character can be part of a word token
+bool IsTokenCharacter(unsigned char character)
+{
+    return (character >= 'a' && character <= 'z') || (character >= 'A' && character <= 'Z') ||
+    (character >= '0' && character <= '9') || character == '_';
+}
+
+// find a word in the token table, adding it while adding is allowed and there is room (NULL otherwise)
+TOKENENTRY* FindToken(TOKENENTRY *table, uint64_t capacity, uint64_t *used, const unsigned char *start, int length, bool add)
+{
+    uint64_t hash = HashContent(start, length);
+    uint64_t slot = hash & (capacity - 1);
+
+    // linear probing
+    while(table[slot].start != NULL)
+    {
+        if(table[slot].hash == hash && table[slot].length == length && memcmp(table[slot].start, start, length) == 0)
+        {
+            return &table[slot];
+        }
+
+        slot = (slot + 1) & (capacity - 1);
+    }
+
+    // keep a quarter of the table empty so probes stay short
+    if(!add || *used >= capacity / 4 * 3)
+    {
+        return NULL;
+    }
+
+    table[slot].start = start;
+    table[slot].hash = hash;
+    table[slot].length = length;
+    table[slot].count = 0;
+    table[slot].symbol = 0;
+    (*used)++;
+
+    return &table[slot];
+}
+
+// order tokens by the characters they save, most first (earliest in the block breaks ties)
+int CompareTokens(const void *a, const void *b)
+{
+    const TOKENENTRY *first = *(TOKENENTRY * const *)a;
+    const TOKENENTRY *second = *(TOKENENTRY * const *)b;
+
+    uint64_t firstSaved = (uint64_t)first->count * (first->length - 1);
+    uint64_t secondSaved = (uint64_t)second->count * (second->length - 1);
+
+    if(firstSaved != secondSaved)
+    {
+        return firstSaved > secondSaved ? -1 : 1;
+    }
+
+    return (first->start > second->start) - (first->start < second->start);
+}
+
+// split a block into words and single characters, counting words while symbols is NULL,
+// otherwise writing vocabulary words as one symbol and everything else as bytes (returns symbols written)
+uint64_t TokenizeBlock(const unsigned char *data, uint64_t length, TOKENENTRY *table, uint64_t capacity, uint64_t *used, uint16_t *symbols)
+{
+    uint64_t count = 0;
+    uint64_t i = 0;
+
+    while(i < length)
+    {
+        if(!IsTokenCharacter(data[i]))
+        {
+            if(symbols != NULL)
+            {
+                symbols[count] = data[i];
+            }
+
+            count++;
+            i++;
+            continue;
+        }
+
+        uint64_t end = i;
+        while(end < length && IsTokenCharacter(data[end]))
+        {
+            end++;
+        }
+
+        TOKENENTRY *token = NULL;
+        if(end - i >= TOKEN_MIN_LENGTH && end - i <= TOKEN_MAX_LENGTH)
+        {
+            token = FindToken(table, capacity, used, data + i, end - i, symbols == NULL);
+        }
+
+        if(symbols == NULL)
+        {
+            if(token != NULL)
+            {
+                token->count++;
+            }
+        }
+
+        else if(token != NULL && token->symbol != 0)
+        {
+            symbols[count++] = token->symbol;
+        }
+
+        else
+        {
+            for(uint64_t j = i; j < end; ++j)
+            {
+                symbols[count++] = data[j];
+            }
+        }
+
+        i = end;
+    }
+
+    return count;
+}
+
+// code token symbols into a new block: mode, tree with two byte symbols, vocabulary, symbol count, then bits
+void WriteTokenBlock(int outputFile, const uint16_t *symbols, uint64_t symbolCount, NODE *root, TOKENENTRY **vocabulary, uint32_t vocabularySize, INDEXENTRY *entry)
+{
+    entry->offset = lseek(outputFile, 0, SEEK_CUR);
+
+    char mode = BLOCK_TOKENS;
+    write(outputFile, &mode, sizeof(char));
+    WriteHuffmanTree(root, outputFile, sizeof(uint16_t));
+
+    // vocabulary: word count, then every word's length and characters in symbol order
+    unsigned char *words = malloc((uint64_t)vocabularySize * (1 + TOKEN_MAX_LENGTH));
+    CODEWORD *codeWords = calloc(TOKEN_ALPHABET_SIZE, sizeof(CODEWORD));
+    if(words == NULL || codeWords == NULL)
+    {
+        printf("Memory Allocation Failed\n");
+        exit(0);
+    }
+
+    uint64_t wordsLength = 0;
+    for(uint32_t i = 0; i < vocabularySize; ++i)
+    {
+        words[wordsLength++] = vocabulary[i]->length;
+        memcpy(words + wordsLength, vocabulary[i]->start, vocabulary[i]->length);
+        wordsLength += vocabulary[i]->length;
+    }
+
+    write(outputFile, &vocabularySize, sizeof(vocabularySize));
+    write(outputFile, words, wordsLength);
+    write(outputFile, &symbolCount, sizeof(symbolCount));
+
+    StoreCodeWords(root, 0, 0, codeWords);
+
+    BITWRITER writer = {outputFile, 0, 0, {0}, 0, false};
+    EncodeTokens(&writer, symbols, symbolCount, codeWords);
+    FlushBits(&writer);
+
+    entry->length = lseek(outputFile, 0, SEEK_CUR) - entry->offset;
+
+    free(words);
+    free(codeWords);
+}
+
+// compress a file as chunks of word tokens, each chunk with its own vocabulary and huffman tree
+bool CompressTokenizedFile(const char *fileName, const char *outputFileName)
+{
+    // input for read
+    int inputFile = open(fileName, O_RDONLY);
+    if(inputFile == -1)
+    {
+        printf("File failed to open.\n");
+        return false;
+    }
+
+    uint64_t size;
+    const unsigned char *data = MapFile(inputFile, &size);
+    if(data == NULL)
+    {
+        printf("File failed to map.\n");
+        close(inputFile);
+        return false;
+    }
+
+    // output for write
+    int outputFile = open(outputFileName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (outputFile == -1)
+    {
+        printf("Output file failed to open.\n");
+        munmap((void *)data, size);
+        close(inputFile);
+        return false;
+    }
+
+    // token table sized for the chunk, up to TOKEN_HASH_SIZE words
+    uint64_t chunkSize = size < TOKEN_BLOCK_SIZE ? size : TOKEN_BLOCK_SIZE;
+    uint64_t capacity = 1024;
+    while(capacity < chunkSize && capacity < TOKEN_HASH_SIZE)
+    {
+        capacity <<= 1;
+    }
+
+    uint64_t count = (size + TOKEN_BLOCK_SIZE - 1) / TOKEN_BLOCK_SIZE;
+    INDEXENTRY *entries = malloc(count * sizeof(INDEXENTRY));
+    TOKENENTRY *table = malloc(capacity * sizeof(TOKENENTRY));
+    TOKENENTRY **vocabulary = malloc(capacity * sizeof(TOKENENTRY *));
+    uint16_t *symbols = malloc(chunkSize * sizeof(uint16_t));
+    int *frequency = malloc(TOKEN_ALPHABET_SIZE * sizeof(int));
+    if(entries == NULL || table == NULL || vocabulary == NULL || symbols == NULL || frequency == NULL)
+    {
+        printf("Memory Allocation Failed\n");
+        exit(0);
+    }
+
+    write(outputFile, ARCHIVE_MAGIC, MAGIC_LENGTH);
+
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t offset = i * TOKEN_BLOCK_SIZE;
+        uint64_t length = size - offset < TOKEN_BLOCK_SIZE ? size - offset : TOKEN_BLOCK_SIZE;
+
+        // step 1: count every word in the chunk
+        memset(table, 0, capacity * sizeof(TOKENENTRY));
+        uint64_t used = 0;
+        TokenizeBlock(data + offset, length, table, capacity, &used, NULL);
+
+        // step 2: words that save the most characters become symbols
+        uint32_t vocabularySize = 0;
+        for(uint64_t j = 0; j < capacity; ++j)
+        {
+            if(table[j].count >= TOKEN_MIN_COUNT)
+            {
+                vocabulary[vocabularySize++] = &table[j];
+            }
+        }
+
+        qsort(vocabulary, vocabularySize, sizeof(TOKENENTRY *), CompareTokens);
+
+        if(vocabularySize > TOKEN_ALPHABET_SIZE - ALPHABET_SIZE)
+        {
+            vocabularySize = TOKEN_ALPHABET_SIZE - ALPHABET_SIZE;
+        }
+
+        for(uint32_t j = 0; j < vocabularySize; ++j)
+        {
+            vocabulary[j]->symbol = ALPHABET_SIZE + j;
+        }
+
+        // step 3: turn the chunk into symbols and count them
+        uint64_t symbolCount = TokenizeBlock(data + offset, length, table, capacity, &used, symbols);
+
+        memset(frequency, 0, TOKEN_ALPHABET_SIZE * sizeof(int));
+        for(uint64_t j = 0; j < symbolCount; ++j)
+        {
+            frequency[symbols[j]]++;
+        }
+
+        // step 4: Build min heap and Huffman tree over bytes and words
+        MINHEAP *minHeap = BuildMinHeap(frequency, TOKEN_ALPHABET_SIZE);
+        NODE *root = BuildHuffmanTree(minHeap);
+
+        // step 5: write the chunk as its own block
+        WriteTokenBlock(outputFile, symbols, symbolCount, root, vocabulary, vocabularySize, &entries[i]);
+        entries[i].originalSize = length;
+
+        // free dynamic memory
+        FreeHuffmanTree(root);
+        FreeMinHeap(minHeap);
+    }
+
+    WriteIndex(outputFile, entries, count);
+
+    free(entries);
+    free(table);
+    free(vocabulary);
+    free(symbols);
+    free(frequency);
+    munmap((void *)data, size);
+    close(inputFile);
+    close(outputFile);
+
+    return true;
+}
+
+// see if file is valid for compression
+bool ASCII(char *inputFileName)
+{
+    // sampled files are only checked where their frequencies are sampled (every character still gets a code)
+    int file = open(inputFileName, O_RDONLY);
+    struct stat fileInfo;
+
+    if(file != -1 && fstat(file, &fileInfo) == 0 && SampleLargeFile(fileInfo.st_size))
+    {
+        int frequency[MAXCHAR] = {0};
+        SampleFrequency(file, fileInfo.st_size, frequency);
+        close(file);
+
+        for(int i = 128; i < ALPHABET_SIZE; ++i)
+        {
+            if(frequency[i] > 0)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    if(file != -1)
+    {
+        close(file);
+    }
+
+    FILE *inputFile = fopen(inputFileName, "r");
+
+    if(inputFile == NULL)
+    {
+        printf("Error: input file failed to open.\n");
+        return false;
+    }
+
+    int character;
+
+    // loop through and check ASCII values of every character in file
+    while((character = fgetc(inputFile)) != EOF)
+    {
+        if(character < 0 || character > 127)
+        {
+            fclose(inputFile);
+            return false;
+        }
+    }
+
+    fclose(inputFile);
+    return true;
+}
+
+// build the huffman tree for a file and write it as a new archive or appended block
+bool RunCompression(const char *fileName, const char *compressedFileName, bool append)
+{
+    // step 1: Calculate frequency of each character
+    int frequency[MAXCHAR] = {0};
+    if(!CalculateFrequency(fileName, frequency))
+    {
+        return false;
+    }
+
+    // a huffman tree needs at least one character
+    bool empty = true;
+    for(int i = 0; i < MAXCHAR; ++i)
+    {
+        if(frequency[i] > 0)
+        {
+            empty = false;
+            break;
+        }
+    }
+
+    if(empty)
+    {
+        printf("Error: can't compress an empty file.\n");
+        return false;
+    }
+
+    #ifdef PRINT
+        PrintFrequencies(frequency);
+    #endif
+
+    // step 2: Build min heap from frequencies
+    MINHEAP *minHeap = BuildMinHeap(frequency, MAXCHAR);
+
+    // step 3: Build Huffman tree
+    NODE *root = BuildHuffmanTree(minHeap);
+
+    char *codes[MAXCHAR] = {0};
+    int array[MAXCHAR], top = 0;
+
+    #ifdef PRINT
+        PrintCodes(root, array, top);
+    #endif
+
+    // step 4: store codes for tree
+    StoreCodes(root, array, top, codes);
+
+    // step 5: write compressed data to file (new archive or new block in an existing one)
+    bool compressed;
+    if(append)
+    {
+        compressed = AppendFile(fileName, compressedFileName, root, codes);
+    }
+
+    else
+    {
+        compressed = CompressFile(fileName, compressedFileName, root, codes);
+    }
+
+    // free dynamic memory
+    FreeCodes(codes);
+    FreeHuffmanTree(root);
+    FreeMinHeap(minHeap);
+
+    return compressed;
+}
+
+
+
+
+// ** DECOMPRESSION CODE **
+
+void GetDecompressedFileName(char *inputFileName, char *decompressedFileName)
+{
+    // copy input name to buffer
+    strcpy(decompressedFileName, inputFileName);
+
+    // find last '.' in name
+    char *dot = strrchr(decompressedFileName, '.');
+
+    // alter filename depending on input file
+    if (strstr(decompressedFileName, "_encoded.oats") != NULL)
+    {
+        strcpy(dot - 8, "_decompressed.txt");
+    }
+    
+    else if (strstr(decompressedFileName, "_compressed.oats") != NULL)
+    {
+        strcpy(dot - 11, "_decompressed.txt");
+    }
+
+    // never decompress onto the input itself
+    else if (dot != NULL)
+    {
+        strcpy(dot, "_decompressed.txt");
+    }
+}
+
+// read huffman tree from file and reconstruct it
+NODE* ReadHuffmanTree(int inputFile)
+{
+    char character;
+    if(read(inputFile, &character, sizeof(char)) != sizeof(char))
+    {
+        return NULL;
+    }
+
+    NODE *node = CreateNewNode(character, 0);
+
+    // recursively read left and right nodes until huffman tree is rebuilt
+    if(character == '\0')
+    {
+        node->leftPtr = ReadHuffmanTree(inputFile);
+        node->rightPtr = ReadHuffmanTree(inputFile);
+    }
+
+    return node;
+}
+
+// rebuild a block's tagged huffman tree from mapped archive data
+NODE* ParseHuffmanTree(const unsigned char *data, uint64_t size, uint64_t *position, int symbolBytes)
+{
+    if(*position >= size)
+    {
+        return NULL;
+    }
+
+    char tag = data[(*position)++];
+
+    // leaves store their character in the following byte(s)
+    if(tag == TREE_LEAF)
+    {
+        if(size - *position < (uint64_t)symbolBytes)
+        {
+            return NULL;
+        }
+
+        int symbol = data[*position];
+        if(symbolBytes > 1)
+        {
+            symbol |= data[*position + 1] << 8;
+        }
+
+        *position += symbolBytes;
+        return CreateNewNode(symbol, 0);
+    }
+
+    if(tag != TREE_INTERNAL)
+    {
+        return NULL;
+    }
+
+    NODE *node = CreateNewNode('\0', 0);
+    node->leftPtr = ParseHuffmanTree(data, size, position, symbolBytes);
+    node->rightPtr = ParseHuffmanTree(data, size, position, symbolBytes);
+
+    // tree ended early
+    if(node->leftPtr == NULL || node->rightPtr == NULL)
+    {
+        FreeHuffmanTree(node);
+        return NULL;
+    }
+
+    return node;
+}
+
+// decode a legacy bitstream to the end of the file by walking the tree
+void DecodeStream(int inputFile, int outputFile, NODE *root)
+{
+    NODE *current = root;
+
+    char buffer[MAXCHAR];
+    ssize_t bytesRead;
+
+    // buffer for output to minimize write calls
+    char outputBuffer[MAXCHAR];
+    int outputBufferIndex = 0;
+
+    // read file in chunks
+    while ((bytesRead = read(inputFile, buffer, sizeof(buffer))) > 0)
+    {
+        // process each byte
+        for (ssize_t i = 0; i < bytesRead; ++i)
+        {
+            // buffer to hold bits up to a byte
+            unsigned char bitBuffer = (unsigned char)buffer[i];
+
+            // process each bit
+            for (int bitCount = 0; bitCount < 8; ++bitCount)
+            {
+                // traverse huffman tree on current bit
+                if ((bitBuffer & (1 << (7 - bitCount))) == 0)
+                {
+                    current = current->leftPtr;
+                }
+                else
+                {
+                    current = current->rightPtr;
+                }
+
+                // if leaf node, write character to output buffer
+                if (!current->leftPtr && !current->rightPtr)
+                {
+                    outputBuffer[outputBufferIndex++] = current->character;
+
+                    // only write when outputBuffer is full
+                    if (outputBufferIndex == sizeof(outputBuffer))
+                    {
+                        write(outputFile, outputBuffer, sizeof(outputBuffer));
+                        outputBufferIndex = 0;
+                    }
+
+                    // reset to root
+                    current = root;
+                }
+            }
+        }
+    }
+
+    // write any leftover data to output
+    if (outputBufferIndex > 0)
+    {
+        write(outputFile, outputBuffer, outputBufferIndex);
+    }
+}
+
+// fill the decode table so every TABLE_BITS-bit prefix maps to a leaf or a subtree
+void BuildDecodeTable(NODE *root, unsigned int code, int depth, int tableBits, DECODEENTRY table[])
+{
+    // leaf: every prefix starting with its code decodes to it
+    if(!root->leftPtr && !root->rightPtr)
+    {
+        unsigned int first = code << (tableBits - depth);
+        unsigned int last = first + (1u << (tableBits - depth));
+
+        for(unsigned int i = first; i < last; ++i)
+        {
+            table[i].node = root;
+            table[i].character = root->character;
+            table[i].length = depth;
+        }
+    }
+
+    // long codes finish by walking the tree from here
+    else if(depth == tableBits)
+    {
+        table[code].node = root;
+        table[code].length = 0;
+    }
+
+    else
+    {
+        BuildDecodeTable(root->leftPtr, code << 1, depth + 1, tableBits, table);
+        BuildDecodeTable(root->rightPtr, (code << 1) | 1, depth + 1, tableBits, table);
+    }
+}
+
+// top up the reader's bit buffer to at least 57 bits (zeros past the end of the stream)
+KERNEL_BODY void RefillBits(BITREADER *reader)
+{
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // load eight bytes at once when far enough from the end
+    if(reader->end - reader->data >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, reader->data, sizeof(word));
+        reader->bits |= __builtin_bswap64(word) >> reader->bitCount;
+        reader->data += (63 - reader->bitCount) >> 3;
+        reader->bitCount |= 56;
+        return;
+    }
+#endif
+
+    while(reader->bitCount <= 56)
+    {
+        uint64_t byte = reader->data < reader->end ? *reader->data++ : 0;
+        reader->bits |= byte << (56 - reader->bitCount);
+        reader->bitCount += 8;
+    }
+}
+
+// decode one character with a table lookup, walking the tree only for long codes
+KERNEL_BODY int DecodeSymbol(BITREADER *reader, const DECODEENTRY table[], int tableBits)
+{
+    if(reader->bitCount < tableBits)
+    {
+        RefillBits(reader);
+    }
+
+    const DECODEENTRY *entry = &table[reader->bits >> (64 - tableBits)];
+
+    if(entry->length > 0)
+    {
+        reader->bits <<= entry->length;
+        reader->bitCount -= entry->length;
+        return entry->character;
+    }
+
+    reader->bits <<= tableBits;
+    reader->bitCount -= tableBits;
+
+    NODE *current = entry->node;
+    while(current->leftPtr && current->rightPtr)
+    {
+        if(reader->bitCount == 0)
+        {
+            RefillBits(reader);
+        }
+
+        current = (reader->bits >> 63) ? current->rightPtr : current->leftPtr;
+        reader->bits <<= 1;
+        reader->bitCount--;
+    }
+
+    return current->character;
+}
+
+// decode count characters from a block's bitstream(s) straight into output
+KERNEL_BODY bool DecodeSymbolsBody(const unsigned char *bits, uint64_t length, bool fourStreams, NODE *root, unsigned char *output, uint64_t count)
+{
+    // block made of a single repeated character has no coded bits
+    if(!root->leftPtr && !root->rightPtr)
+    {
+        memset(output, root->character, count);
+        return true;
+    }
+
+    DECODEENTRY *table = malloc((1 << TABLE_BITS) * sizeof(DECODEENTRY));
+    if(table == NULL)
+    {
+        printf("Memory Allocation Failed\n");
+        exit(0);
+    }
+
+    BuildDecodeTable(root, 0, 0, TABLE_BITS, table);
+
+    bool decoded = true;
+
+    if(!fourStreams)
+    {
+        BITREADER reader = {bits, bits + length, 0, 0};
+
+        for(uint64_t i = 0; i < count; ++i)
+        {
+            output[i] = DecodeSymbol(&reader, table, TABLE_BITS);
+        }
+    }
+
+    else
+    {
+        // jump table: characters per stream, then byte length of every stream but the last
+        uint64_t jumpTable[STREAM_COUNT];
+        uint64_t streamBytes = 0;
+
+        if(length < sizeof(jumpTable))
+        {
+            decoded = false;
+        }
+
+        else
+        {
+            memcpy(jumpTable, bits, sizeof(jumpTable));
+            bits += sizeof(jumpTable);
+            length -= sizeof(jumpTable);
+
+            // each stream must fit in what is left of the block on its own, so lengths can't wrap
+            for(int i = 1; i < STREAM_COUNT && decoded; ++i)
+            {
+                decoded = jumpTable[i] <= length - streamBytes;
+                streamBytes += decoded ? jumpTable[i] : 0;
+            }
+        }
+
+        // the encoder always splits the characters into STREAM_COUNT equal runs plus a remainder
+        if(!decoded || jumpTable[0] != count / STREAM_COUNT)
+        {
+            decoded = false;
+        }
+
+        else
+        {
+            uint64_t segment = jumpTable[0];
+            const unsigned char *start = bits;
+
+            BITREADER reader0 = {start, start + jumpTable[1], 0, 0};
+            start += jumpTable[1];
+            BITREADER reader1 = {start, start + jumpTable[2], 0, 0};
+            start += jumpTable[2];
+            BITREADER reader2 = {start, start + jumpTable[3], 0, 0};
+            start += jumpTable[3];
+            BITREADER reader3 = {start, bits + length, 0, 0};
+
+            unsigned char *output0 = output;
+            unsigned char *output1 = output0 + segment;
+            unsigned char *output2 = output1 + segment;
+            unsigned char *output3 = output2 + segment;
+
+            // four independent dependency chains per iteration
+            for(uint64_t i = 0; i < segment; ++i)
+            {
+                output0[i] = DecodeSymbol(&reader0, table, TABLE_BITS);
+                output1[i] = DecodeSymbol(&reader1, table, TABLE_BITS);
+                output2[i] = DecodeSymbol(&reader2, table, TABLE_BITS);
+                output3[i] = DecodeSymbol(&reader3, table, TABLE_BITS);
+            }
+
+            // last stream holds the leftover characters
+            for(uint64_t i = segment; i < count - 3 * segment; ++i)
+            {
+                output3[i] = DecodeSymbol(&reader3, table, TABLE_BITS);
+            }
+        }
+    }
+
+    free(table);
+
+    return decoded;
+}
+
+bool DecodeSymbolsScalar(const unsigned char *bits, uint64_t length, bool fourStreams, NODE *root, unsigned char *output, uint64_t count)
+{
+    return DecodeSymbolsBody(bits, length, fourStreams, root, output, count);
+}
+
+#ifdef KERNEL_DISPATCH
+TARGET_SSE42 bool DecodeSymbolsSSE42(const unsigned char *bits, uint64_t length, bool fourStreams, NODE *root, unsigned char *output, uint64_t count)
+{
+    return DecodeSymbolsBody(bits, length, fourStreams, root, output, count);
+}
+
+TARGET_AVX2 bool DecodeSymbolsAVX2(const unsigned char *bits, uint64_t length, bool fourStreams, NODE *root, unsigned char *output, uint64_t count)
+{
+    return DecodeSymbolsBody(bits, length, fourStreams, root, output, count);
+}
+#endif
+
+// decode a token block: vocabulary words are copied out whole, other symbols are single characters
+bool DecodeTokenBlock(const unsigned char *block, uint64_t length, unsigned char *output, uint64_t originalSize)
+{
+    uint64_t position = 1;
+    NODE *root = ParseHuffmanTree(block, length, &position, sizeof(uint16_t));
+    if(root == NULL)
+    {
+        return false;
+    }
+
+    // vocabulary words point straight into the mapped block
+    uint32_t vocabularySize = 0;
+    bool decoded = length - position >= sizeof(vocabularySize);
+
+    if(decoded)
+    {
+        memcpy(&vocabularySize, block + position, sizeof(vocabularySize));
+        position += sizeof(vocabularySize);
+        decoded = vocabularySize <= TOKEN_ALPHABET_SIZE - ALPHABET_SIZE;
+    }
+
+    const unsigned char **words = malloc((vocabularySize + 1) * sizeof(unsigned char *));
+    unsigned char *wordLengths = malloc(vocabularySize + 1);
+    if(words == NULL || wordLengths == NULL)
+    {
+        printf("Memory Allocation Failed\n");
+        exit(0);
+    }
+
+    for(uint32_t i = 0; decoded && i < vocabularySize; ++i)
+    {
+        if(position >= length || block[position] == 0 || block[position] > length - position - 1)
+        {
+            decoded = false;
+            break;
+        }
+
+        wordLengths[i] = block[position++];
+        words[i] = block + position;
+        position += wordLengths[i];
+    }
+
+    // every symbol writes at least one character
+    uint64_t symbolCount = 0;
+    if(decoded && length - position >= sizeof(symbolCount))
+    {
+        memcpy(&symbolCount, block + position, sizeof(symbolCount));
+        position += sizeof(symbolCount);
+        decoded = symbolCount <= originalSize;
+    }
+
+    else
+    {
+        decoded = false;
+    }
+
+    DECODEENTRY *table = NULL;
+    bool singleSymbol = !root->leftPtr && !root->rightPtr;
+
+    if(decoded && !singleSymbol)
+    {
+        table = malloc((1 << TOKEN_TABLE_BITS) * sizeof(DECODEENTRY));
+        if(table == NULL)
+        {
+            printf("Memory Allocation Failed\n");
+            exit(0);
+        }
+
+        BuildDecodeTable(root, 0, 0, TOKEN_TABLE_BITS, table);
+    }
+
+    BITREADER reader = {block + position, block + length, 0, 0};
+    uint64_t written = 0;
+
+    for(uint64_t i = 0; decoded && i < symbolCount; ++i)
+    {
+        int symbol = singleSymbol ? root->character : DecodeSymbol(&reader, table, TOKEN_TABLE_BITS);
+
+        if(symbol < ALPHABET_SIZE)
+        {
+            decoded = written < originalSize;
+            output[written] = symbol;
+            written += decoded;
+        }
+
+        else
+        {
+            uint32_t word = symbol - ALPHABET_SIZE;
+            decoded = word < vocabularySize && wordLengths[word] <= originalSize - written;
+
+            if(decoded)
+            {
+                memcpy(output + written, words[word], wordLengths[word]);
+                written += wordLengths[word];
+            }
+        }
+    }
+
+    decoded = decoded && written == originalSize;
+
+    free(table);
+    free(words);
+    free(wordLengths);
+    FreeHuffmanTree(root);
+
+    return decoded;
+}
+
+// decode one mapped block into its place in the mapped output
+bool DecodeBlock(const unsigned char *block, uint64_t length, unsigned char *output, uint64_t originalSize, NODE *sharedTree)
+{
+    if(length < 1)
+    {
+        return false;
+    }
+
+    char mode = block[0];
+    uint64_t position = 1;
+
+    // token blocks carry a vocabulary and are never transformed or shared
+    if(mode == BLOCK_TOKENS)
+    {
+        return DecodeTokenBlock(block, length, output, originalSize);
+    }
+
+    if((mode & ~(BLOCK_FOURSTREAMS | BLOCK_BWT | BLOCK_SHAREDTREE)) != 0)
+    {
+        return false;
+    }
+
+    // solid archive blocks can use the archive's shared tree instead of their own
+    NODE *ownTree = NULL;
+    NODE *root = sharedTree;
+
+    if(!(mode & BLOCK_SHAREDTREE))
+    {
+        ownTree = ParseHuffmanTree(block, length, &position, sizeof(char));
+        root = ownTree;
+    }
+
+    if(root == NULL)
+    {
+        return false;
+    }
+
+    bool decoded;
+
+    // transformed blocks decode into a scratch buffer and are then transformed back
+    if(mode & BLOCK_BWT)
+    {
+        // symbols coded, then the row each inverse chain starts from
+        uint64_t transform[1 + BWT_CHAINS];
+
+        if(length - position < sizeof(transform))
+        {
+            FreeHuffmanTree(ownTree);
+            return false;
+        }
+
+        memcpy(transform, block + position, sizeof(transform));
+        position += sizeof(transform);
+
+        // zero run coding at most doubles the chunk
+        if(transform[0] > 2 * originalSize)
+        {
+            FreeHuffmanTree(ownTree);
+            return false;
+        }
+
+        unsigned char *symbols = malloc(transform[0] + 1);
+        if(symbols == NULL)
+        {
+            printf("Memory Allocation Failed\n");
+            exit(0);
+        }
+
+        decoded = kernels.decodeSymbols(block + position, length - position, mode & BLOCK_FOURSTREAMS, root, symbols, transform[0]) &&
+        UndoTransform(symbols, transform[0], transform + 1, output, originalSize);
+
+        free(symbols);
+    }
+
+    else
+    {
+        decoded = kernels.decodeSymbols(block + position, length - position, mode & BLOCK_FOURSTREAMS, root, output, originalSize);
+    }
+
+    FreeHuffmanTree(ownTree);
+
+    return decoded;
+}
+
+// see if a block's original size could have come from its coded length (checked before the output is allocated)
+bool BlockSizeFits(const unsigned char *block, uint64_t length, uint64_t originalSize, NODE *sharedTree)
+{
+    if(length < 1)
+    {
+        return false;
+    }
+
+    char mode = block[0];
+
+    // transformed and token blocks are cut from chunks of a fixed size
+    if(mode == BLOCK_TOKENS)
+    {
+        return originalSize <= TOKEN_BLOCK_SIZE;
+    }
+
+    if(mode & BLOCK_BWT)
+    {
+        return originalSize <= BWT_BLOCK_SIZE;
+    }
+
+    // a tree with a single leaf codes its character with no bits, otherwise every character costs at least one
+    bool singleLeaf = (mode & BLOCK_SHAREDTREE) ? sharedTree != NULL && sharedTree->leftPtr == NULL :
+    length >= 2 && block[1] == TREE_LEAF;
+
+    return singleLeaf || originalSize <= 8 * length;
+}
+
+// decode every block listed in an archive's index, in order
+bool DecompressArchive(int inputFile, int outputFile, INDEXENTRY *entries, uint64_t count)
+{
+    struct stat fileInfo;
+    fstat(inputFile, &fileInfo);
+
+    // blocks must lie inside the file and their output sizes must add up
+    uint64_t outputSize = 0;
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        if(entries[i].offset > (uint64_t)fileInfo.st_size ||
+        entries[i].length > (uint64_t)fileInfo.st_size - entries[i].offset ||
+        entries[i].originalSize > UINT64_MAX - outputSize)
+        {
+            return false;
+        }
+
+        outputSize += entries[i].originalSize;
+    }
+
+    if(outputSize == 0)
+    {
+        return true;
+    }
+
+    // map the archive and the output so streams can be decoded straight into place
+    const unsigned char *archive = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, inputFile, 0);
+    if(archive == MAP_FAILED)
+    {
+        return false;
+    }
+
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        if(!BlockSizeFits(archive + entries[i].offset, entries[i].length, entries[i].originalSize, NULL))
+        {
+            munmap((void *)archive, fileInfo.st_size);
+            return false;
+        }
+    }
+
+    if(ftruncate(outputFile, outputSize) == -1)
+    {
+        munmap((void *)archive, fileInfo.st_size);
+        return false;
+    }
+
+    unsigned char *output = mmap(NULL, outputSize, PROT_READ | PROT_WRITE, MAP_SHARED, outputFile, 0);
+    if(output == MAP_FAILED)
+    {
+        munmap((void *)archive, fileInfo.st_size);
+        return false;
+    }
+
+    bool decoded = true;
+    uint64_t outputPosition = 0;
+
+    for(uint64_t i = 0; i < count && decoded; ++i)
+    {
+        decoded = DecodeBlock(archive + entries[i].offset, entries[i].length, output + outputPosition, entries[i].originalSize, NULL);
+        outputPosition += entries[i].originalSize;
+    }
+
+    munmap(output, outputSize);
+    munmap((void *)archive, fileInfo.st_size);
+
+    return decoded;
+}
+
+// name for an extracted solid archive member, next to the archive ("_decompressed" goes before its extension)
+void GetMemberFileName(const char *archiveFileName, const char *memberName, char *outputFileName)
+{
+    const char *archiveSlash = strrchr(archiveFileName, '/');
+    int directoryLength = archiveSlash == NULL ? 0 : archiveSlash - archiveFileName + 1;
+
+    memcpy(outputFileName, archiveFileName, directoryLength);
+    strcpy(outputFileName + directoryLength, memberName);
+
+    char *slash = strrchr(outputFileName, '/');
+    char *dot = strrchr(outputFileName, '.');
+
+    // no extension (or only a leading dot) in the last part of the path
+    if(dot == NULL || dot == outputFileName || (slash != NULL && dot <= slash + 1))
+    {
+        strcat(outputFileName, "_decompressed");
+        return;
+    }
+
+    char extension[500];
+    strcpy(extension, dot);
+    strcpy(dot, "_decompressed");
+    strcat(outputFileName, extension);
+}
+
+// write every member of a solid archive to its own file
+bool ExtractSolidArchive(const char *inputFileName, int inputFile, INDEXENTRY *entries, uint64_t count, off_t fileTableOffset)
+{
+    struct stat fileInfo;
+    fstat(inputFile, &fileInfo);
+
+    // blocks must lie inside the file
+    for(uint64_t i = 0; i < count; ++i)
+    {
+        if(entries[i].offset > (uint64_t)fileInfo.st_size ||
+        entries[i].length > (uint64_t)fileInfo.st_size - entries[i].offset)
+        {
+            return false;
+        }
+    }
+
+    const unsigned char *archive = mmap(NULL, fileInfo.st_size, PROT_READ, MAP_PRIVATE, inputFile, 0);
+    if(archive == MAP_FAILED)
+    {
+        return false;
+    }
+
+    // shared tree right after the header (absent if every member is empty)
+    uint64_t position = MAGIC_LENGTH;
+    NODE *sharedTree = ParseHuffmanTree(archive, fileTableOffset, &position, sizeof(char));
+
+    // file table runs up to the trailer
+    uint64_t tableEnd = fileInfo.st_size - 2 * sizeof(uint64_t) - MAGIC_LENGTH;
+    position = fileTableOffset;
+    bool extracted = true;
+
+    while(extracted && position < tableEnd)
+    {
+        uint64_t size, block;
+        uint16_t nameLength;
+        char name[500];
+        char outputFileName[1020];
+
+        if(tableEnd - position < 2 * sizeof(uint64_t) + sizeof(uint16_t))
+        {
+            extracted = false;
+            break;
+        }
+
+        memcpy(&size, archive + position, sizeof(uint64_t));
+        memcpy(&block, archive + position + sizeof(uint64_t), sizeof(uint64_t));
+        memcpy(&nameLength, archive + position + 2 * sizeof(uint64_t), sizeof(uint16_t));
+        position += 2 * sizeof(uint64_t) + sizeof(uint16_t);
+
+        // member sizes must match their block
+        if(nameLength == 0 || nameLength >= sizeof(name) || tableEnd - position < nameLength ||
+        (size == 0) != (block == NO_BLOCK) || (block != NO_BLOCK && (block >= count || entries[block].originalSize != size ||
+        !BlockSizeFits(archive + entries[block].offset, entries[block].length, size, sharedTree))))
+        {
+            extracted = false;
+            break;
+        }
+
+        memcpy(name, archive + position, nameLength);
+        name[nameLength] = '\0';
+        position += nameLength;
+
+        // a name that climbs out of the archive's directory means a corrupt (or hostile) archive
+        if(strlen(name) != nameLength || !MemberNameSafe(name))
+        {
+            extracted = false;
+            break;
+        }
+
+        GetMemberFileName(inputFileName, name, outputFileName);
+
+        int outputFile = open(outputFileName, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+        if(outputFile == -1)
+        {
+            printf("Error: %s failed to open.\n", outputFileName);
+            extracted = false;
+            break;
+        }
+
+        if(size > 0)
+        {
+            unsigned char *output = MAP_FAILED;
+            if(ftruncate(outputFile, size) == 0)
+            {
+                output = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, outputFile, 0);
+            }
+
+            extracted = output != MAP_FAILED &&
+            DecodeBlock(archive + entries[block].offset, entries[block].length, output, size, sharedTree);
+
+            if(output != MAP_FAILED)
+            {
+                munmap(output, size);
+            }
+        }
+
+        close(outputFile);
+
+        if(!extracted)
+        {
+            remove(outputFileName);
+        }
+    }
+
+    FreeHuffmanTree(sharedTree);
+    munmap((void *)archive, fileInfo.st_size);
+
+    return extracted;
+}
+
+// decompress file with huffman tree
+bool DecompressFile(const char *inputFileName, const char *outputFileName)
+{
+    // input for read
+    int inputFile = open(inputFileName, O_RDONLY);
+    if(inputFile == -1)
+    {
+        printf("File failed to open.\n");
+        return false;
+    }
+
+    uint64_t count;
+    off_t indexOffset;
+    off_t fileTableOffset;
+    INDEXENTRY *entries = ReadIndex(inputFile, &count, &indexOffset, &fileTableOffset);
+
+    // solid archive members are written to their own files instead of outputFileName
+    if(entries != NULL && fileTableOffset >= 0)
+    {
+        bool extracted = ExtractSolidArchive(inputFileName, inputFile, entries, count, fileTableOffset);
+        free(entries);
+        close(inputFile);
+
+        if(!extracted)
+        {
+            printf("Failed to extract solid archive. File is corrupt or incorrect key provided.\n");
+            return false;
+        }
+
+        // delete temporary file 
+        if (remove(inputFileName) != 0) 
+        {
+            printf("Error deleting original file.\n");
+        }
+
+        return true;
+    }
+
+    // output for write
+    int outputFile = open(outputFileName, O_RDWR | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
+    if (outputFile == -1)
+    {
+        printf("Output file failed to open.\n");
+        free(entries);
+        close(inputFile);
+        return false;
+    }
+
+    // block archive
+    if(entries != NULL)
+    {
+        bool decoded = DecompressArchive(inputFile, outputFile, entries, count);
+        free(entries);
+
+        if(!decoded)
+        {
+            close(inputFile);
+            close(outputFile);
+            remove(outputFileName);
+            printf("Failed to read archive block. File is corrupt or incorrect key provided.\n");
+            return false;
+        }
+    }
+
+    // legacy file with a single tree at the start
+    else
+    {
+        // read huffman tree into memory
+        NODE *root = ReadHuffmanTree(inputFile);
+
+        // avoid seg faults if the wrong key is provided
+        if(root == NULL || (root->leftPtr == NULL && root->rightPtr == NULL))
+        {
+            close(inputFile);
+            close(outputFile);
+            remove(outputFileName);
+            FreeHuffmanTree(root);
+            printf("Failed to read Huffman Tree. Incorrect key provided.\n");
+            return false;
+        }
+
+        DecodeStream(inputFile, outputFile, root);
+
+        // free dynamic memory
+        FreeHuffmanTree(root);
+    }
+
+    close(inputFile);
+    close(outputFile);
+
+    // delete temporary file 
+    if (remove(inputFileName) != 0) 
+    {
+        printf("Error deleting original file.\n");
+    }
+
+    return true;
+}
+
+
+
+
+
+
+// ** ENCODE / DECODE
+
+void GetEncodedFileName(char *inputFileName, char *encodedFileName)
+{
+    // copy file name into buffer
+    strcpy(encodedFileName, inputFileName);
+
+    // find last '.' in name
+    char *dot = strrchr(encodedFileName, '.');
+
+    if(strstr(encodedFileName, "_compressed.oats") != NULL)
+    {
+        strcpy(dot - 11, "_encoded.oats");
+        //printf("\n%s\n", encodedFileName);
+    }
+
+    else if(strstr(encodedFileName, "_encoded.oats") != NULL)
+    {
+        strcpy(dot - 8, "_compressed.oats");
+        //printf("\n%s\n", encodedFileName);
+    }
+
+    else
+    {
+        // get original extension
+        const char *extension = strchr(inputFileName, '.');
+        size_t extensionLength = strlen(dot);
+        char extensionBuffer[16];
+        strcpy(extensionBuffer, dot);
+
+        char *encodedPosition = strstr(encodedFileName, "_encoded");
+
+        // decoding filename
+        if(encodedPosition != NULL && (encodedPosition + 8 == dot))
+        {
+            strcpy(encodedPosition, extensionBuffer);
+        }
+
+        // encoding filename
+        else
+        {
+            // cut off end of original filename
+            *dot = '\0';
+
+            // add data to old filename
+            strcat(encodedFileName, "_encoded");
+            strcat(encodedFileName, extensionBuffer);
+        }
+    }
+}
+
+// bit masks for every position of a chunk (a byte's mask only depends on its offset % MAXCHAR)
+void BuildKeyPattern(const char *key, size_t keyLength, unsigned char pattern[MAXCHAR])
+{
+    for (size_t i = 0; i < MAXCHAR; ++i)
+    {
+        // bit mask to encode file based on key input
+        pattern[i] = 1 << (key[i % keyLength] % 8);
+    }
+}
+
+// xor whole chunks that line up with the pattern
+void XorChunksScalar(unsigned char *data, uint64_t chunks, const unsigned char pattern[MAXCHAR])
+{
+    for (uint64_t i = 0; i < chunks; ++i, data += MAXCHAR)
+    {
+        for (size_t k = 0; k < MAXCHAR; ++k)
+        {
+            data[k] ^= pattern[k];
+        }
+    }
+}
+
+#ifdef KERNEL_DISPATCH
+TARGET_SSE42 void XorChunksSSE42(unsigned char *data, uint64_t chunks, const unsigned char pattern[MAXCHAR])
+{
+    for (uint64_t i = 0; i < chunks; ++i, data += MAXCHAR)
+    {
+        for (size_t k = 0; k < MAXCHAR; k += sizeof(__m128i))
+        {
+            __m128i block = _mm_loadu_si128((const __m128i *)(data + k));
+            __m128i mask = _mm_loadu_si128((const __m128i *)(pattern + k));
+            _mm_storeu_si128((__m128i *)(data + k), _mm_xor_si128(block, mask));
+        }
+    }
+}
+
+TARGET_AVX2 void XorChunksAVX2(unsigned char *data, uint64_t chunks, const unsigned char pattern[MAXCHAR])
+{
+    for (uint64_t i = 0; i < chunks; ++i, data += MAXCHAR)
+    {
+        for (size_t k = 0; k < MAXCHAR; k += sizeof(__m256i))
+        {
+            __m256i block = _mm256_loadu_si256((const __m256i *)(data + k));
+            __m256i mask = _mm256_loadu_si256((const __m256i *)(pattern + k));
+            _mm256_storeu_si256((__m256i *)(data + k), _mm256_xor_si256(block, mask));
+        }
+    }
+}
+#endif
+
+// xor data found at offset in the file with the key pattern
+void XorPattern(unsigned char *data, uint64_t size, uint64_t offset, const unsigned char pattern[MAXCHAR])
+{
+    uint64_t i = 0;
+    size_t j = offset % MAXCHAR;
+
+    // finish the chunk the data starts in
+    while (i < size && j != 0)
+    {
+        data[i++] ^= pattern[j];
+        j = (j + 1) % MAXCHAR;
+    }
+
+    // whole chunks line up with the pattern
+    uint64_t chunks = (size - i) / MAXCHAR;
+    kernels.xorChunks(data + i, chunks, pattern);
+    i += chunks * MAXCHAR;
+
+    for (j = 0; i < size; ++i, ++j)
+    {
+        data[i] ^= pattern[j];
+    }
+}
+
+void* XorThread(void *argument)
+{
+    XORTASK *task = argument;
+    XorPattern(task->data, task->size, task->offset, task->pattern);
+    return NULL;
+}
+
+// xor a file into a new copy in chunks (removeInput deletes the original once the copy is complete)
+bool EncodeCopy(const char *inputFileName, const char *outputFileName, const unsigned char pattern[MAXCHAR], bool removeInput)
+{
+    FILE *inputFile = fopen(inputFileName, "rb");
+    if(inputFile == NULL)
+    {
+        printf("Input file failed to open.\n");
+        return false;
+    }
+
+    FILE *outputFile = fopen(outputFileName, "wb");
+    if(outputFile == NULL)
+    {
+        printf("Output file failed to open.\n");
+        fclose(inputFile);
+        return false;
+    }
+
+    // fixed buffer size
+    unsigned char buffer[MAXCHAR];
+    size_t bytesRead;
+    uint64_t offset = 0;
+    bool written = true;
+
+    // read and write file in chunks
+    while (written && (bytesRead = fread(buffer, 1, MAXCHAR, inputFile)) > 0)
+    {
+        XorPattern(buffer, bytesRead, offset, pattern);
+        offset += bytesRead;
+
+        written = fwrite(buffer, 1, bytesRead, outputFile) == bytesRead;
+        fflush(outputFile);
+    }
+
+    written = !ferror(inputFile) && fclose(outputFile) == 0 && written;
+    fclose(inputFile);
+
+    // never lose the original to a partial copy
+    if(!written)
+    {
+        printf("Error writing %s.\n", outputFileName);
+        remove(outputFileName);
+        return false;
+    }
+
+    if(removeInput && remove(inputFileName) != 0)
+    {
+        printf("Error deleting original file.\n");
+    }
+
     return true;
 }
 
+// xor a file through a shared mapping (split across threads when large) and rename it
+bool EncodeInPlace(const char *inputFileName, const char *outputFileName, const unsigned char pattern[MAXCHAR])
+{
+    // read only files can't be changed where they are, but can still be copied and removed
+    int file = open(inputFileName, O_RDWR);
+    if(file == -1)
+    {
+        return EncodeCopy(inputFileName, outputFileName, pattern, true);
+    }
+
+    struct stat fileInfo;
+    fstat(file, &fileInfo);
+    uint64_t size = fileInfo.st_size;
 
+    if(size > 0)
+    {
+        unsigned char *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+        if(data == MAP_FAILED)
+        {
+            close(file);
+            return EncodeCopy(inputFileName, outputFileName, pattern, true);
+        }
 
+        madvise(data, size, MADV_SEQUENTIAL);
 
-// ** DECOMPRESSION CODE **
+        long threadCount = 1;
+        if(size >= ENCODE_THREAD_THRESHOLD)
+        {
+            threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+            threadCount = threadCount < 1 ? 1 : (threadCount > ENCODE_THREADS ? ENCODE_THREADS : threadCount);
+        }
 
-void GetDecompressedFileName(char *inputFileName, char *decompressedFileName)
+        pthread_t threads[ENCODE_THREADS];
+        bool started[ENCODE_THREADS] = {false};
+        XORTASK tasks[ENCODE_THREADS];
+        uint64_t slice = size / threadCount;
+
+        for(long t = 0; t < threadCount; ++t)
+        {
+            tasks[t].data = data + t * slice;
+            tasks[t].size = t == threadCount - 1 ? size - t * slice : slice;
+            tasks[t].offset = t * slice;
+            tasks[t].pattern = pattern;
+        }
+
+        // this thread takes the first slice (and any slice whose thread failed to start)
+        for(long t = 1; t < threadCount; ++t)
+        {
+            started[t] = pthread_create(&threads[t], NULL, XorThread, &tasks[t]) == 0;
+        }
+
+        for(long t = 0; t < threadCount; ++t)
+        {
+            if(!started[t])
+            {
+                XorThread(&tasks[t]);
+            }
+        }
+
+        for(long t = 1; t < threadCount; ++t)
+        {
+            if(started[t])
+            {
+                pthread_join(threads[t], NULL);
+            }
+        }
+
+        munmap(data, size);
+    }
+
+    close(file);
+
+    // transformed file takes its new name in one step
+    if(rename(inputFileName, outputFileName) != 0)
+    {
+        printf("Error renaming file.\n");
+        return false;
+    }
+
+    return true;
+}
+
+bool Encode(const char *inputFileName, const char *outputFileName, const char *key)
 {
-    // copy input name to buffer
-    strcpy(decompressedFileName, inputFileName);
+    // NULL key
+    size_t keyLength = strlen(key);
+    if(keyLength == 0)
+    {
+        printf("Key can't be empty.\n");
+        return false;
+    }
 
-    // find last '.' in name
-    char *dot = strrchr(decompressedFileName, '.');
+    unsigned char pattern[MAXCHAR];
+    BuildKeyPattern(key, keyLength, pattern);
 
-    // alter filename depending on input file
-    if (strstr(decompressedFileName, "_encoded.oats") != NULL)
+    // original would be deleted anyway, so transform it where it is
+    if (strstr(inputFileName, "_encoded.oats") == NULL)
     {
-        strcpy(dot - 8, "_decompressed.txt");
+        return EncodeInPlace(inputFileName, outputFileName, pattern);
     }
-    
-    else if (strstr(decompressedFileName, "_compressed.oats") != NULL)
+
+    // encrypted archives are kept, so decode into a copy
+    return EncodeCopy(inputFileName, outputFileName, pattern, false);
+}
+
+
+
+
+
+
+// ** DAEMON **
+
+// see if a file name has an extension the naming functions can work with
+bool ValidExtension(const char *fileName)
+{
+    const char *dot = strrchr(fileName, '.');
+    return dot != NULL && strlen(dot) < 16;
+}
+
+// run one request and describe the result in response
+bool HandleRequest(char *request, char *response, size_t responseSize)
+{
+    char command[16], fileName[500], argument[500];
+    int fields = sscanf(request, "%15s %499s %499s", command, fileName, argument);
+
+    if(fields < 2)
     {
-        strcpy(dot - 11, "_decompressed.txt");
+        snprintf(response, responseSize, "ERROR malformed request");
+        return false;
+    }
+
+    // find file extension
+    const char *extension = strchr(fileName, '.');
+    bool isOats = extension && strcmp(extension, ".oats") == 0;
+
+    char outputFileName[520];
+
+    // compress <file>, bwt <file> or append <file> <archive>
+    if(strcmp(command, "compress") == 0 || strcmp(command, "bwt") == 0 || strcmp(command, "tokens") == 0 ||
+    strcmp(command, "append") == 0)
+    {
+        bool append = strcmp(command, "append") == 0;
+        bool transform = strcmp(command, "bwt") == 0;
+        bool tokens = strcmp(command, "tokens") == 0;
+
+        if(isOats || !ValidExtension(fileName) || !ASCII(fileName))
+        {
+            snprintf(response, responseSize, "ERROR can't compress this file");
+            return false;
+        }
+
+        if(append)
+        {
+            if(fields != 3 || strstr(argument, ".oats") == NULL)
+            {
+                snprintf(response, responseSize, "ERROR can only append to .oats files");
+                return false;
+            }
+
+            strcpy(outputFileName, argument);
+        }
+
+        else
+        {
+            GetCompressedFileName(fileName, outputFileName);
+        }
+
+        bool compressed;
+        if(transform)
+        {
+            compressed = CompressTransformedFile(fileName, outputFileName);
+        }
+
+        else if(tokens)
+        {
+            compressed = CompressTokenizedFile(fileName, outputFileName);
+        }
+
+        else
+        {
+            compressed = RunCompression(fileName, outputFileName, append);
+        }
+
+        if(!compressed)
+        {
+            snprintf(response, responseSize, "ERROR compression failed");
+            return false;
+        }
+    }
+
+    // pack <list file>
+    else if(strcmp(command, "pack") == 0)
+    {
+        if(isOats || !ValidExtension(fileName))
+        {
+            snprintf(response, responseSize, "ERROR can't pack this file");
+            return false;
+        }
+
+        GetCompressedFileName(fileName, outputFileName);
+
+        if(!PackSolidArchive(fileName, outputFileName))
+        {
+            snprintf(response, responseSize, "ERROR packing failed");
+            return false;
+        }
+    }
+
+    // decompress <file>
+    else if(strcmp(command, "decompress") == 0)
+    {
+        if(!isOats)
+        {
+            snprintf(response, responseSize, "ERROR can only decompress .oats files");
+            return false;
+        }
+
+        GetDecompressedFileName(fileName, outputFileName);
+
+        if(!DecompressFile(fileName, outputFileName))
+        {
+            snprintf(response, responseSize, "ERROR decompression failed");
+            return false;
+        }
+    }
+
+    // encode <file> <key> (encrypts or decrypts, same as menu option 5)
+    else if(strcmp(command, "encode") == 0)
+    {
+        if(fields != 3 || strlen(argument) > 100)
+        {
+            snprintf(response, responseSize, "ERROR encode needs a key of at most 100 characters");
+            return false;
+        }
+
+        // never encode source file
+        if(strcmp(fileName, "Compression.c") == 0 || !ValidExtension(fileName))
+        {
+            snprintf(response, responseSize, "ERROR this file can't be encoded");
+            return false;
+        }
+
+        GetEncodedFileName(fileName, outputFileName);
+
+        if(!Encode(fileName, outputFileName, argument))
+        {
+            snprintf(response, responseSize, "ERROR encoding failed");
+            return false;
+        }
+    }
+
+    else
+    {
+        snprintf(response, responseSize, "ERROR unknown command %s", command);
+        return false;
     }
+
+    snprintf(response, responseSize, "OK %s", outputFileName);
+    return true;
 }
 
-// read huffman tree from file and reconstruct it
-NODE* ReadHuffmanTree(int inputFile)
-{
-    char character;
-    if(read(inputFile, &character, sizeof(char)) != sizeof(char))
-    {
-        return NULL;
-    }
+// answer every request on one connection until the client hangs up or the daemon stops
+void* ServeConnection(void *argument)
+{
+    DAEMONCONNECTION *connection = argument;
+    DAEMONSTATE *state = connection->state;
+    int client = connection->client;
+    free(connection);
+
+    // request buffer stays allocated for the whole connection
+    char request[DAEMON_REQUEST_SIZE];
+    char response[DAEMON_REQUEST_SIZE];
+
+    size_t used = 0;
+    ssize_t bytesRead;
+    bool open = true;
+
+    // a connection can carry any number of requests
+    while(open && (bytesRead = read(client, request + used, sizeof(request) - 1 - used)) > 0)
+    {
+        used += bytesRead;
+
+        char *line = request;
+        char *newline;
+
+        while(open && (newline = memchr(line, '\n', used - (line - request))) != NULL)
+        {
+            *newline = '\0';
+
+            // count running requests so shutdown can wait for them
+            pthread_mutex_lock(&state->lock);
+            bool counted = state->running;
+            state->busy += counted;
+            pthread_mutex_unlock(&state->lock);
+
+            if(!counted)
+            {
+                snprintf(response, sizeof(response), "ERROR daemon is shutting down");
+                open = false;
+            }
+
+            else if(strcmp(line, "shutdown") == 0)
+            {
+                snprintf(response, sizeof(response), "OK shutdown");
+                open = false;
+
+                // wake the accept loop
+                pthread_mutex_lock(&state->lock);
+                state->running = false;
+                pthread_mutex_unlock(&state->lock);
+                shutdown(state->server, SHUT_RDWR);
+            }
+
+            else
+            {
+                HandleRequest(line, response, sizeof(response));
+            }
+
+            fflush(stdout);
+            strcat(response, "\n");
+            write(client, response, strlen(response));
+
+            if(counted)
+            {
+                pthread_mutex_lock(&state->lock);
+                state->busy--;
+                pthread_cond_signal(&state->idle);
+                pthread_mutex_unlock(&state->lock);
+            }
+
+            line = newline + 1;
+        }
 
-    NODE *node = CreateNewNode(character, 0);
+        // keep a partial request for the next read
+        used -= line - request;
+        memmove(request, line, used);
 
-    // recursively read left and right nodes until huffman tree is rebuilt
-    if(character == '\0')
-    {
-        node->leftPtr = ReadHuffmanTree(inputFile);
-        node->rightPtr = ReadHuffmanTree(inputFile);
+        if(used == sizeof(request) - 1)
+        {
+            snprintf(response, sizeof(response), "ERROR request too long\n");
+            write(client, response, strlen(response));
+            used = 0;
+        }
     }
 
-    return node;
+    close(client);
+
+    pthread_mutex_lock(&state->lock);
+    state->connections--;
+    pthread_mutex_unlock(&state->lock);
+
+    return NULL;
 }
 
-// decompress file with huffman tree
-void DecompressFile(const char *inputFileName, const char *outputFileName)
+// serve newline separated requests on a unix socket until a client sends "shutdown"
+int RunDaemon(const char *socketPath)
 {
-    // input for read
-    int inputFile = open(inputFileName, O_RDONLY);
-    if(inputFile == -1)
+    // a client hanging up early must not kill the daemon
+    signal(SIGPIPE, SIG_IGN);
+
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+
+    if(strlen(socketPath) >= sizeof(address.sun_path))
     {
-        printf("File failed to open.\n");
-        exit(0);
+        printf("Error: socket path is too long.\n");
+        return 1;
     }
 
-    // output for write
-    int outputFile = open(outputFileName, O_WRONLY | O_CREAT, S_IRUSR | S_IWUSR);
-    if (outputFile == -1)
+    strcpy(address.sun_path, socketPath);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server == -1)
     {
-        printf("Output file failed to open.\n");
-        close(inputFile);
-        exit(0);
+        printf("Socket failed to open.\n");
+        return 1;
     }
 
-    // read huffman tree into memory
-    NODE *root = ReadHuffmanTree(inputFile);
+    // clear a socket left behind by an earlier daemon
+    unlink(socketPath);
 
-    // avoid seg faults if the wrong key is provided
-    if(root == NULL || (root->leftPtr == NULL && root->rightPtr == NULL))
+    if(bind(server, (struct sockaddr *)&address, sizeof(address)) == -1 || listen(server, DAEMON_BACKLOG) == -1)
     {
-        close(inputFile);
-        close(outputFile);
-        remove(outputFileName);
-        FreeHuffmanTree(root);
-        printf("Failed to read Huffman Tree. Incorrect key provided.\n");
-        exit(0);
+        printf("Socket failed to bind to %s.\n", socketPath);
+        close(server);
+        return 1;
     }
 
-    NODE *current = root;
+    printf("Listening on %s\n", socketPath);
+    fflush(stdout);
 
-    char buffer[MAXCHAR];
-    ssize_t bytesRead;
+    DAEMONSTATE state = {server, true, 0, 0, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
 
-    // buffer for output to minimize write calls
-    char outputBuffer[MAXCHAR];
-    int outputBufferIndex = 0;
+    pthread_attr_t attributes;
+    pthread_attr_init(&attributes);
+    pthread_attr_setdetachstate(&attributes, PTHREAD_CREATE_DETACHED);
 
-    // read file in chunks
-    while ((bytesRead = read(inputFile, buffer, sizeof(buffer))) > 0)
+    // every connection gets its own thread so an idle or slow client never holds up the rest,
+    // up to DAEMON_CONNECTIONS at once
+    while(true)
     {
-        // process each byte
-        for (ssize_t i = 0; i < bytesRead; ++i)
-        {
-            // buffer to hold bits up to a byte
-            unsigned char bitBuffer = (unsigned char)buffer[i];
+        int client = accept(server, NULL, NULL);
 
-            // process each bit
-            for (int bitCount = 0; bitCount < 8; ++bitCount)
+        pthread_mutex_lock(&state.lock);
+        bool running = state.running;
+        bool full = state.connections >= DAEMON_CONNECTIONS;
+        state.connections += running && client != -1 && !full;
+        pthread_mutex_unlock(&state.lock);
+
+        if(!running)
+        {
+            if(client != -1)
             {
-                // traverse huffman tree on current bit
-                if ((bitBuffer & (1 << (7 - bitCount))) == 0)
-                {
-                    current = current->leftPtr;
-                }
-                else
-                {
-                    current = current->rightPtr;
-                }
+                close(client);
+            }
 
-                // if leaf node, write character to output buffer
-                if (!current->leftPtr && !current->rightPtr)
-                {
-                    outputBuffer[outputBufferIndex++] = current->character;
+            break;
+        }
 
-                    // only write when outputBuffer is full
-                    if (outputBufferIndex == sizeof(outputBuffer))
-                    {
-                        write(outputFile, outputBuffer, sizeof(outputBuffer));
-                        outputBufferIndex = 0;
-                    }
+        if(client == -1)
+        {
+            continue;
+        }
 
-                    // reset to root
-                    current = root;
-                }
-            }
+        if(full)
+        {
+            const char *response = "ERROR too many connections\n";
+            write(client, response, strlen(response));
+            close(client);
+            continue;
         }
-    }
 
-    // write any leftover data to output
-    if (outputBufferIndex > 0)
-    {
-        write(outputFile, outputBuffer, outputBufferIndex);
-    }
+        DAEMONCONNECTION *connection = malloc(sizeof(DAEMONCONNECTION));
+        if(connection == NULL)
+        {
+            printf("Memory Allocation Failed\n");
+            exit(0);
+        }
 
-    close(inputFile);
-    close(outputFile);
+        connection->client = client;
+        connection->state = &state;
 
-    // free dynamic memory
-    FreeHuffmanTree(root);
+        pthread_t thread;
+        if(pthread_create(&thread, &attributes, ServeConnection, connection) != 0)
+        {
+            free(connection);
+            close(client);
 
-    // delete temporary file 
-    if (remove(inputFileName) != 0) 
-    {
-        printf("Error deleting original file.\n");
+            pthread_mutex_lock(&state.lock);
+            state.connections--;
+            pthread_mutex_unlock(&state.lock);
+        }
     }
-}
-
-
-
 
+    // let requests already running finish, idle connections are dropped
+    pthread_mutex_lock(&state.lock);
+    while(state.busy > 0)
+    {
+        pthread_cond_wait(&state.idle, &state.lock);
+    }
+    pthread_mutex_unlock(&state.lock);
 
+    pthread_attr_destroy(&attributes);
+    close(server);
+    unlink(socketPath);
 
-// ** ENCODE / DECODE
+    return 0;
+}
 
-void GetEncodedFileName(char *inputFileName, char *encodedFileName)
+// send requests to a running daemon (from the command line or one per line on stdin)
+int RunClient(const char *socketPath, int requestCount, char *requests[])
 {
-    // copy file name into buffer
-    strcpy(encodedFileName, inputFileName);
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
 
-    // find last '.' in name
-    char *dot = strrchr(encodedFileName, '.');
+    if(strlen(socketPath) >= sizeof(address.sun_path))
+    {
+        printf("Error: socket path is too long.\n");
+        return 1;
+    }
 
-    if(strstr(encodedFileName, "_compressed.oats") != NULL)
+    strcpy(address.sun_path, socketPath);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(server == -1 || connect(server, (struct sockaddr *)&address, sizeof(address)) == -1)
     {
-        strcpy(dot - 11, "_encoded.oats");
-        //printf("\n%s\n", encodedFileName);
+        printf("Failed to connect to daemon at %s.\n", socketPath);
+        return 1;
     }
 
-    else if(strstr(encodedFileName, "_encoded.oats") != NULL)
+    FILE *responses = fdopen(server, "r");
+    char request[DAEMON_REQUEST_SIZE];
+    char response[DAEMON_REQUEST_SIZE];
+    int status = 0;
+
+    // single request built from the command line
+    if(requestCount > 0)
     {
-        strcpy(dot - 8, "_compressed.oats");
-        //printf("\n%s\n", encodedFileName);
+        request[0] = '\0';
+        for(int i = 0; i < requestCount; ++i)
+        {
+            if(strlen(request) + strlen(requests[i]) + 2 >= sizeof(request))
+            {
+                printf("Error: request is too long.\n");
+                fclose(responses);
+                return 1;
+            }
+
+            strcat(request, requests[i]);
+            strcat(request, i + 1 < requestCount ? " " : "\n");
+        }
     }
 
-    else
+    // otherwise read requests from stdin over the same connection
+    while(requestCount > 0 || fgets(request, sizeof(request), stdin) != NULL)
     {
-        // get original extension
-        const char *extension = strchr(inputFileName, '.');
-        size_t extensionLength = strlen(dot);
-        char extensionBuffer[16];
-        strcpy(extensionBuffer, dot);
+        if(strchr(request, '\n') == NULL)
+        {
+            strcat(request, "\n");
+        }
 
-        char *encodedPosition = strstr(encodedFileName, "_encoded");
+        write(server, request, strlen(request));
 
-        // decoding filename
-        if(encodedPosition != NULL && (encodedPosition + 8 == dot))
+        if(fgets(response, sizeof(response), responses) == NULL)
         {
-            strcpy(encodedPosition, extensionBuffer);
+            printf("Daemon closed the connection.\n");
+            status = 1;
+            break;
         }
 
-        // encoding filename
-        else
+        printf("%s", response);
+
+        if(strncmp(response, "OK", 2) != 0)
         {
-            // cut off end of original filename
-            *dot = '\0';
+            status = 1;
+        }
 
-            // add data to old filename
-            strcat(encodedFileName, "_encoded");
-            strcat(encodedFileName, extensionBuffer);
+        if(requestCount > 0)
+        {
+            break;
         }
     }
+
+    fclose(responses);
+    return status;
 }
 
-void Encode(const char *inputFileName, const char *outputFileName, const char *key)
+
+
+
+
+
+// ** CPU DISPATCH **
+
+// pick the fastest copy of every kernel this cpu can run (OATS_CPU=scalar|sse4.2 caps the choice)
+void SelectKernels(void)
 {
-    FILE *inputFile = fopen(inputFileName, "rb");
-    if(inputFile == NULL)
-    {
-        printf("Input file failed to open.\n");
-        exit(0);
-    }
+    kernels = (KERNELS){"scalar", CountBytesScalar, EncodeSymbolsScalar, DecodeSymbolsScalar, XorChunksScalar};
 
-    FILE *outputFile = fopen(outputFileName, "wb");
-    if(outputFile == NULL)
-    {
-        printf("Output file failed to open.\n");
-        fclose(inputFile);
-        exit(0);
-    }
+#ifdef KERNEL_DISPATCH
+    const char *limit = getenv("OATS_CPU");
+    bool allowSSE42 = limit == NULL || strcmp(limit, "scalar") != 0;
+    bool allowAVX2 = allowSSE42 && (limit == NULL || strcmp(limit, "sse4.2") != 0);
 
-    // NULL key
-    size_t keyLength = strlen(key);
-    if(keyLength == 0)
-    {
-        printf("Key can't be empty.\n");
-        fclose(inputFile);
-        fclose(outputFile);
-        exit(0);
-    }
+    __builtin_cpu_init();
 
-    // fixed buffer size
-    unsigned char buffer[MAXCHAR];
-    size_t bytesRead;
+    // every feature the copies were compiled for, since virtual machines can mask any of them
+    bool hasSSE42 = __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+    bool hasAVX2 = hasSSE42 && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") && __builtin_cpu_supports("bmi2");
 
-    // read and write file in chunks
-    while ((bytesRead = fread(buffer, 1, MAXCHAR, inputFile)) > 0)
+    if(allowAVX2 && hasAVX2)
     {
-        for (size_t i = 0; i < bytesRead; ++i)
-        {
-            // bit mask to encode file based on key input
-            unsigned char bitMask = 1 << (key[i % keyLength] % 8);
-            buffer[i] ^= bitMask;
-        }
-
-        fwrite(buffer, 1, bytesRead, outputFile);
-        fflush(outputFile);
+        kernels = (KERNELS){"avx2", CountBytesAVX2, EncodeSymbolsAVX2, DecodeSymbolsAVX2, XorChunksAVX2};
     }
 
-    fclose(inputFile);
-    fclose(outputFile);
-
-    // delete temporary files
-    if (strstr(inputFileName, "_encoded.oats") == NULL)
+    else if(allowSSE42 && hasSSE42)
     {
-        if (remove(inputFileName) != 0) 
-        {
-            printf("Error deleting original file.\n");
-        }
+        kernels = (KERNELS){"sse4.2", CountBytesSSE42, EncodeSymbolsSSE42, DecodeSymbolsSSE42, XorChunksSSE42};
     }
+#endif
 }
 
 
@@ -737,6 +4022,22 @@ void Encode(const char *inputFileName, const char *outputFileName, const char *k
 
 int main(int argc, char *argv[])
 {
+    SelectKernels();
+
+    // going over a file size limit fails the write instead of killing the process
+    signal(SIGXFSZ, SIG_IGN);
+
+    // long running daemon and its client skip the interactive menu
+    if (argc == 3 && strcmp(argv[1], "--daemon") == 0)
+    {
+        return RunDaemon(argv[2]);
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--client") == 0)
+    {
+        return RunClient(argv[2], argc - 3, argv + 3);
+    }
+
     // file not provided on command line
     if (argc != 2)
     {
@@ -755,17 +4056,19 @@ int main(int argc, char *argv[])
 
     // menu
     printf("1. compress and encrypt file\n2. decrypt and decompress file\n");
-    printf("\n3. compress a file\n4. decompress a file\n5. encrypt / decrypt a file\n\nYour Choice: ");
+    printf("\n3. compress a file\n4. decompress a file\n5. encrypt / decrypt a file\n");
+    printf("6. append a file to a .oats archive\n7. compress a text file with the BWT transform\n");
+    printf("8. pack the files listed in a file into a solid archive\n9. compress a text file as word tokens\n\nYour Choice: ");
     scanf("%d", &choice);
 
-    if(choice < 1 || choice > 5)
+    if(choice < 1 || choice > 9)
     {
         printf("Invalid Choice\n");
         exit(0);
     }
 
     // Compression
-    if(choice == 1 || choice == 3)
+    if(choice == 1 || choice == 3 || choice == 6 || choice == 7 || choice == 9)
     {
         // don't compress already compressed files
         if(isOats)
@@ -783,42 +4086,66 @@ int main(int argc, char *argv[])
 
         // find name for compressed file
         char compressedFileName[500];
-        GetCompressedFileName(fileName, compressedFileName);
-
-        // step 1: Calculate frequency of each character
-        int frequency[MAXCHAR] = {0};
-        CalculateFrequency(fileName, frequency);
 
-        #ifdef PRINT
-            PrintFrequencies(frequency);
-        #endif
+        // appending goes into an existing archive chosen by the user
+        if(choice == 6)
+        {
+            printf("Enter the .oats archive to append to: ");
+            if(scanf("%499s", compressedFileName) != 1 || strstr(compressedFileName, ".oats") == NULL)
+            {
+                printf("Error: can only append to .oats files.\n");
+                exit(0);
+            }
+        }
 
-        // step 2: Build min heap from frequencies
-        MINHEAP *minHeap = BuildMinHeap(frequency);
+        else
+        {
+            GetCompressedFileName(fileName, compressedFileName);
+        }
 
-        // step 3: Build Huffman tree
-        NODE *root = BuildHuffmanTree(minHeap);
+        // steps 1-5: build the huffman tree and write compressed data
+        if(choice == 7)
+        {
+            if(!CompressTransformedFile(fileName, compressedFileName))
+            {
+                exit(0);
+            }
+        }
 
-        char *codes[MAXCHAR] = {0};
-        int array[MAXCHAR], top = 0;
+        else if(choice == 9)
+        {
+            if(!CompressTokenizedFile(fileName, compressedFileName))
+            {
+                exit(0);
+            }
+        }
 
-        #ifdef PRINT
-            PrintCodes(root, array, top);
-        #endif
+        else if(!RunCompression(fileName, compressedFileName, choice == 6))
+        {
+            exit(0);
+        }
 
-        // step 4: store codes for tree
-        StoreCodes(root, array, top, codes);
+        // necessary if file is being encoded immediately after compression
+        strcpy(fileName, compressedFileName);
+    }
 
-        // step 5: write compressed data to file
-        CompressFile(fileName, compressedFileName, root, codes);
+    // Solid archive of every file named in the list file
+    if(choice == 8)
+    {
+        // list itself is never an archive
+        if(isOats)
+        {
+            printf("Error: can't pack a .oats file.\n");
+            exit(0);
+        }
 
-        // free dynamic memory
-        FreeCodes(codes);
-        FreeHuffmanTree(root);
-        FreeMinHeap(minHeap);
+        char compressedFileName[500];
+        GetCompressedFileName(fileName, compressedFileName);
 
-        // necessary if file is being encoded immediately after compression
-        strcpy(fileName, compressedFileName);
+        if(!PackSolidArchive(fileName, compressedFileName))
+        {
+            exit(0);
+        }
     }
 
     // Encrypt / Decrypt
@@ -845,7 +4172,10 @@ int main(int argc, char *argv[])
         GetEncodedFileName(fileName, encodedFileName);
 
         // encode to new file with key
-        Encode(fileName, encodedFileName, key);
+        if(!Encode(fileName, encodedFileName, key))
+        {
+            exit(0);
+        }
 
         strcpy(fileName, encodedFileName);
 
@@ -867,7 +4197,10 @@ int main(int argc, char *argv[])
         GetDecompressedFileName(fileName, decompressedFileName);
 
         // decompress file to .txt
-        DecompressFile(fileName, decompressedFileName);
+        if(!DecompressFile(fileName, decompressedFileName))
+        {
+            exit(0);
+        }
     }
 
     return 0;
@@ -0,0 +1,69 @@
+#!/bin/sh
+# run every menu option and the daemon over the training corpus to collect a profile
+# usage: train.sh <binary> <work directory> <files...>
+set -e
+
+binary=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+work=$2
+shift 2
+
+rm -rf "$work"
+mkdir -p "$work"
+
+number=0
+for file in "$@"
+do
+    number=$((number + 1))
+    name=sample$number
+    cp "$file" "$work/$name.txt"
+    echo "$name.txt" >> "$work/list.txt"
+
+    # huffman, burrows-wheeler and word token round trips
+    (cd "$work" && cp $name.txt plain$number.txt && echo 3 | "$binary" plain$number.txt > /dev/null)
+    (cd "$work" && echo 4 | "$binary" plain${number}_compressed.oats > /dev/null)
+    (cd "$work" && cp $name.txt bwt$number.txt && echo 7 | "$binary" bwt$number.txt > /dev/null)
+    (cd "$work" && echo 4 | "$binary" bwt${number}_compressed.oats > /dev/null)
+    (cd "$work" && cp $name.txt token$number.txt && echo 9 | "$binary" token$number.txt > /dev/null)
+    (cd "$work" && echo 4 | "$binary" token${number}_compressed.oats > /dev/null)
+
+    # append a second copy to an archive
+    (cd "$work" && cp $name.txt append$number.txt && echo 3 | "$binary" append$number.txt > /dev/null)
+    (cd "$work" && cp $name.txt extra$number.txt && printf '6\nappend%s_compressed.oats\n' $number | "$binary" extra$number.txt > /dev/null)
+    (cd "$work" && echo 4 | "$binary" append${number}_compressed.oats > /dev/null)
+
+    # encrypt and decrypt, alone and combined with compression
+    (cd "$work" && cp $name.txt key$number.txt && printf '5\ntrainingkey\n' | "$binary" key$number.txt > /dev/null)
+    (cd "$work" && printf '5\ntrainingkey\n' | "$binary" key${number}_encoded.txt > /dev/null)
+    (cd "$work" && cp $name.txt secure$number.txt && printf '1\ntrainingkey\n' | "$binary" secure$number.txt > /dev/null)
+    (cd "$work" && printf '2\ntrainingkey\n' | "$binary" secure${number}_encoded.oats > /dev/null)
+
+    cp "$file" "$work/daemon$number.txt"
+    printf 'compress daemon%s.txt\ndecompress daemon%s_compressed.oats\n' $number $number >> "$work/requests.txt"
+done
+
+# one solid archive of every sample
+(cd "$work" && echo 8 | "$binary" list.txt > /dev/null)
+(cd "$work" && echo 4 | "$binary" list_compressed.oats > /dev/null)
+
+# the same round trips through the daemon, over one client connection
+(cd "$work" && "$binary" --daemon daemon.sock > /dev/null) &
+while [ ! -S "$work/daemon.sock" ]
+do
+    sleep 0.1
+done
+
+echo shutdown >> "$work/requests.txt"
+"$binary" --client "$work/daemon.sock" < "$work/requests.txt" > /dev/null
+wait
+
+for number in $(seq 1 $number)
+do
+    cmp "$work/sample$number.txt" "$work/plain${number}_decompressed.txt"
+    cmp "$work/sample$number.txt" "$work/bwt${number}_decompressed.txt"
+    cmp "$work/sample$number.txt" "$work/token${number}_decompressed.txt"
+    cmp "$work/sample$number.txt" "$work/key$number.txt"
+    cmp "$work/sample$number.txt" "$work/sample${number}_decompressed.txt"
+    cmp "$work/sample$number.txt" "$work/secure${number}_decompressed.txt"
+    cmp "$work/sample$number.txt" "$work/daemon${number}_decompressed.txt"
+    cat "$work/sample$number.txt" "$work/sample$number.txt" | cmp - "$work/append${number}_decompressed.txt"
+done